@@ -3,6 +3,7 @@
 KEYID=0
 make -C c_utils
 mkdir -p data
+./c_utils/eht_print_params > data/params.json
 ./c_utils/eht_keygen $KEYID
 mv private.sk data/ # used only for signature generation
 mv public.pk data/
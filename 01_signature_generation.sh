@@ -6,6 +6,11 @@ BATCHSIZE=10000
 
 NBATCHES=$(( $NSIGS / $BATCHSIZE ))
 
+# STREAM=1 signs, computes C*z and accumulates the covariance in one c_utils/eht_pipeline
+# process instead, and only writes data/cz.cz.npy and data/cz.stats.npy (02 then has nothing
+# to do, and 03 reads these). Set it for all three scripts.
+STREAM=${STREAM:-}
+
 # Parallelize signature generation
 siggen_task(){
     FNAME="data/SIGS_${BATCHSIZE}_${1}"
@@ -16,6 +21,9 @@ siggen_task(){
 # Number of threads to use
 NT=`grep -c ^processor /proc/cpuinfo`
 NT=$(( $NT - 1 ))
+if [ $NT -lt 1 ]; then
+    NT=1
+fi
 
 # https://unix.stackexchange.com/questions/103920/parallelize-a-bash-for-loop
 # initialize a semaphore with a given number of tokens
@@ -41,6 +49,11 @@ run_with_lock(){
     )&
 }
 
+if [ -n "$STREAM" ]; then
+    ./c_utils/eht_pipeline -t $NT -o data/cz data/private.sk data/public.pk $NSIGS
+    exit
+fi
+
 open_sem $NT
 for thing in `seq 1 $NBATCHES`; do
     run_with_lock siggen_task $thing
@@ -7,10 +7,18 @@ processCz_task(){
 }
 
 # Process the signatures using the public key to get a numpy array file with Cz values
+# With STREAM=1, 01_signature_generation.sh already did this
+if [ -n "${STREAM:-}" ]; then
+    echo "STREAM is set; C*z was computed by 01_signature_generation.sh"
+    exit
+fi
 
 # Number of threads to use
 NT=`grep -c ^processor /proc/cpuinfo`
 NT=$(( $NT - 1 ))
+if [ $NT -lt 1 ]; then
+    NT=1
+fi
 
 # https://unix.stackexchange.com/questions/103920/parallelize-a-bash-for-loop
 # initialize a semaphore with a given number of tokens
@@ -3,4 +3,12 @@
 ## Run the first part ("morphing") of the [DucasNguyen12] algorithm for solving the Hidden Zonotope Problem.
 # Reads C*z vectors from data/raw_Cz.dat
 # Writes transformation matrix L^-1 to data/morphed.Li.npy and transformed vectors to data/morphed.vecs.npy
-sage morph.py data/raw_Cz.dat data/morphed
+# DTYPE=float32 or DTYPE=bfloat16 stores the morphed vectors with less precision (half or a quarter of the size);
+# the descent still accumulates everything in float64. Check with eht_descent -V against a float64 copy if in doubt.
+DTYPE=${DTYPE:-float64}
+# With STREAM=1, reads the C*z and their moments written by c_utils/eht_pipeline in 01_signature_generation.sh
+if [ -n "${STREAM:-}" ]; then
+	sage morph.py data/cz.cz.npy data/morphed --stats data/cz.stats.npy --dtype "$DTYPE"
+else
+	sage morph.py data/raw_Cz.dat data/morphed --dtype "$DTYPE"
+fi
@@ -7,20 +7,57 @@
 INFILE="data/morphed"
 OUTDIR="data/descent/`hostname`/" # can be run across multiple machines
 
+# Update rule used by each descent run: gradient (Algorithm 2 of DucasNguyen12), fixedpoint (FastICA-style) or linesearch
+UPDATE=${UPDATE:-gradient}
+# DESCENT=native runs all descents in one multithreaded c_utils/eht_descent process.
+# DESCENT=sage runs one descent.py process per core instead.
+# DESCENT=worker makes this machine an eht_descent worker for the coordinator at COORDINATOR (HOST:PORT),
+# which was started with e.g.
+#   python3 coordinator.py 0.0.0.0:4747 data/descent/coordinator/output_vecs.json
+# and stops all workers once every column has been found (RUNS below is then set on the coordinator).
+DESCENT=${DESCENT:-native}
+COORDINATOR=${COORDINATOR:-}
+# Extra arguments for descent.py, e.g. "--subsample" to start each run on a small random subsample
+DESCENT_ARGS=${DESCENT_ARGS:-}
+# Seed for the starting points of the native runner; use a different one on every machine
+SEED=${SEED:-$( od -An -N4 -tu4 /dev/urandom | tr -d ' ' )}
+
+# eht_descent has no subsampled mode, so do not silently drop the arguments meant for descent.py
+if [ -n "$DESCENT_ARGS" ] && [ "$DESCENT" != "sage" ]; then
+	echo "DESCENT_ARGS=\"$DESCENT_ARGS\" is only used with DESCENT=sage (descent.py)" >&2
+	exit 1
+fi
+if [ "$DESCENT" = "worker" ] && [ -z "$COORDINATOR" ]; then
+	echo "DESCENT=worker needs the address of the coordinator in COORDINATOR (HOST:PORT or unix:PATH)" >&2
+	exit 1
+fi
+
 NPROCS=$( grep -c ^processor /proc/cpuinfo )
 NPROCS=$(( $NPROCS - 1 ))
+if [ $NPROCS -lt 1 ]; then
+	NPROCS=1
+fi
 
 # Coupon collector problem: to find all 484 distinct vectors, we expect it to take roughly 4400 successful runs of descent
 # We'll do 6600 because not every descent run is successful and to make it more likely that we find all 484
-# NOTE: update this number if running across multiple machines
-ITERSPERJOB=$(( 6600 / $NPROCS + 1 ))
+# (Only used by the native and sage runners; with DESCENT=worker, the coordinator counts the runs of all machines, see --runs)
+RUNS=6600
 
 mkdir -p "$OUTDIR"
-echo "Launching $NPROCS descent jobs, each doing $ITERSPERJOB runs"
-for i in $( seq $NPROCS ); do
-	(sage descent.py "$INFILE" "$OUTDIR"/vecs_$i "$ITERSPERJOB" > /dev/null ; echo "Job $i finished" ) &
-done
-wait
-echo "All jobs finished; merging and deduplicating"
-cat "$OUTDIR"/vecs_* | sort | uniq > "$OUTDIR"/output_vecs.json
+if [ "$DESCENT" = "native" ]; then
+	echo "Launching $RUNS descent runs ($UPDATE updates) on $NPROCS threads"
+	./c_utils/eht_descent -t "$NPROCS" -n "$RUNS" -s "$SEED" -u "$UPDATE" "$INFILE" "$OUTDIR"/output_vecs.json
+elif [ "$DESCENT" = "worker" ]; then
+	echo "Running descents ($UPDATE updates) on $NPROCS threads for the coordinator at $COORDINATOR"
+	./c_utils/eht_descent -t "$NPROCS" -u "$UPDATE" -c "$COORDINATOR" "$INFILE" "$OUTDIR"/output_vecs.json
+else
+	ITERSPERJOB=$(( $RUNS / $NPROCS + 1 ))
+	echo "Launching $NPROCS descent jobs, each doing $ITERSPERJOB runs ($UPDATE updates)"
+	for i in $( seq $NPROCS ); do
+		(sage descent.py "$INFILE" "$OUTDIR"/vecs_$i "$ITERSPERJOB" --update "$UPDATE" $DESCENT_ARGS > /dev/null ; echo "Job $i finished" ) &
+	done
+	wait
+	echo "All jobs finished; merging and deduplicating"
+	cat "$OUTDIR"/vecs_* | sort | uniq > "$OUTDIR"/output_vecs.json
+fi
 echo "Recovered $( wc -l "$OUTDIR"/output_vecs.json ) distinct vectors"
@@ -3,7 +3,13 @@
 ## Once the columns of C are recovered, we can reconstruct (most of) C, T, and B.
 # We don't recover the full private key but we recover enough of it that we can produce signatures by solving CVP in a very low dimension (28 for the category 1 parameters).
 
-# Collect and deduplicate the columns found in step 4 (which may be run on multiple machines)
-cat data/descent/*/output_vecs.json | sort | uniq > data/C_vecs.json
+# Collect the columns found in step 4 (which may be run on multiple machines). eht_colfilter
+# drops duplicates (also up to sign or other multiples) and vectors that cannot be columns of C,
+# and puts the most plausible candidates first.
+cat data/descent/*/output_vecs.json | ./c_utils/eht_colfilter data/public.pk > data/C_vecs.json
 
-python3 partial_key_recovery.py data/public.json data/C_vecs.json data/partial_key.json -v
+# NATIVE=1 does the GF(47) linear algebra in c_utils/libgf47.so instead of Sage
+NATIVE=${NATIVE:-}
+# JOBS=N probes competing candidate pairs for the column order on N processes
+JOBS=${JOBS:-1}
+python3 partial_key_recovery.py data/public.json data/C_vecs.json data/partial_key.ehtk -v ${NATIVE:+--native} --jobs "$JOBS"
@@ -2,6 +2,14 @@
 
 ## Using the partial private key, forge a signature of an arbitrary message
 MESSAGE='Forgery!'
-python3 fake_sign.py data/partial_key.json "$MESSAGE" > data/forged_signature.sig
+# NATIVE=1 forges with c_utils/eht_forge, without Sage
+NATIVE=${NATIVE:-}
+if [ -n "$NATIVE" ]; then
+    ./c_utils/eht_forge data/partial_key.ehtk "$MESSAGE" > data/forged_signature.sig
+else
+    # The message-independent part of the signer (C1 inverse, LLL-reduced lattice for the
+    # CVP in T) is saved to data/prepared_key.npz, which fake_sign.py also takes in place of the key.
+    python3 fake_sign.py data/partial_key.ehtk "$MESSAGE" --save-prepared data/prepared_key.npz > data/forged_signature.sig
+fi
 echo "Forged signature is in data/forged_signature.sig"
 ./c_utils/eht_verify data/public.pk <data/forged_signature.sig
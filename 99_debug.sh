@@ -1,7 +1,8 @@
 #!/bin/sh
 
 mkdir -p debug
-c_utils/eht_print_sk data/private.sk > debug/private.json
-c_utils/eht_print_pk data/public.pk > debug/public.json
+# Binary key containers (.ehtk, see c_utils/ehtk.h); without the second argument, the keys are printed as JSON
+c_utils/eht_print_sk data/private.sk debug/private.ehtk
+c_utils/eht_print_pk data/public.pk debug/public.ehtk
 
-python test_attack.py debug/private.json debug/public.json
+python test_attack.py debug/private.ehtk debug/public.ehtk
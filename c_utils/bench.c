@@ -0,0 +1,349 @@
+// Micro-benchmarks for the hot paths of the reference implementation.
+//
+//   eht_bench [-t SECONDS] [-f FILTER] [-b BASELINE.json] [-r RATIO] > bench.json
+//
+// Every benchmark calls one function over and over on fixed inputs (a key
+// generated from a fixed seed, and signatures made with it). The calls are
+// timed in samples of a calibrated number of calls each, for about SECONDS per
+// benchmark (at least 3 samples), and the per-call cost of the samples is
+// reported as JSON: median, mean and standard deviation in cycles (rdtsc on
+// x86, nanoseconds elsewhere), and calls per second.
+//
+// With -b, the medians are compared against a JSON file written by an earlier
+// run: each benchmark gets its baseline and the ratio (current / baseline),
+// and the exit status is 1 if any benchmark is slower than RATIO (default
+// 1.10) times its baseline. FILTER runs only the benchmarks whose name
+// contains it.
+
+#define _GNU_SOURCE
+
+#include <getopt.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "api.h"
+#include "parameters.h"
+#include "general_functions.h"
+#include "keccak.h"
+#include "rng.h"
+#include "eht_keygen.h"
+#include "eht_siggen.h"
+#include "eht_sigver.h"
+
+#include "common.h"
+
+// Defined in eht_siggen.c
+void sk_to_C1cp(const unsigned char* sk, unsigned char* C1cp);
+void generate_C(unsigned char** C, unsigned short** C1_index, unsigned char** C1_value);
+void solve_a(unsigned char** C, unsigned short** C1_index, unsigned char** C1_value, unsigned char* C1cp, unsigned char** h, unsigned char** a);
+void solve_z(unsigned char** T, unsigned char** a, unsigned char** y, unsigned char** z);
+
+// Defined in eht_sigver.c
+void pk_to_A(const unsigned char *pk, unsigned char **A);
+void sm_to_mx(const unsigned char* sm, unsigned long long smlen, unsigned char* m, unsigned long long* mlen, unsigned char** x);
+
+#define MSG_LEN 33
+
+#if defined(__x86_64__) || defined(__i386__)
+static const char* UNIT = "cycles";
+static uint64_t ticks(void) { return __rdtsc(); }
+#else
+static const char* UNIT = "ns";
+static uint64_t ticks(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+#endif
+
+static double seconds(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Inputs shared by all benchmarks
+static struct {
+  unsigned char pk[CRYPTO_PUBLICKEYBYTES], sk[CRYPTO_SECRETKEYBYTES];
+  expanded_sk esk;
+  unsigned char msg[MSG_LEN], *sm, *m;
+  unsigned long long smlen, mlen;
+  char* sm_hex;
+  unsigned char **A, **h, **a, **y, **z, **x, **Ax;
+  unsigned char **NN1, **NN2, **NN3;
+  unsigned char *shake;
+  int shake_len;
+  unsigned char rnd[48];
+} in;
+
+// Fills the inputs: a key pair from a fixed seed, a message and its signature
+static void setup(void) {
+  unsigned char seed[48];
+  for (int i = 0; i < 48; i++) {
+    seed[i] = i;
+  }
+  randombytes_init(seed, NULL, 256);
+  crypto_sign_keypair(in.pk, in.sk);
+  expand_sk(in.sk, &in.esk);
+  randombytes(in.msg, MSG_LEN);
+
+  in.sm = malloc(MSG_LEN + CRYPTO_BYTES);
+  in.m = malloc(MSG_LEN + CRYPTO_BYTES);
+  sig_gen(in.sm, &in.smlen, in.msg, MSG_LEN, in.sk);
+  in.sm_hex = malloc(2 * in.smlen + 2);
+  for (unsigned long long i = 0; i < in.smlen; i++) {
+    sprintf(in.sm_hex + 2 * i, "%02X", in.sm[i]);
+  }
+
+  in.A = allocate_unsigned_char_matrix_memory(M, N);
+  in.h = allocate_unsigned_char_matrix_memory(M, 1);
+  in.a = allocate_unsigned_char_matrix_memory(M + D, 1);
+  in.y = allocate_unsigned_char_matrix_memory(N, 1);
+  in.z = allocate_unsigned_char_matrix_memory(K * N, 1);
+  in.x = allocate_unsigned_char_matrix_memory(N, 1);
+  in.Ax = allocate_unsigned_char_matrix_memory(M, 1);
+  in.NN1 = allocate_unsigned_char_matrix_memory(N, N);
+  in.NN2 = allocate_unsigned_char_matrix_memory(N, N);
+  in.NN3 = allocate_unsigned_char_matrix_memory(N, N);
+  for (int i = 0; i < N; i++) {
+    for (int j = 0; j < N; j++) {
+      in.NN1[i][j] = NIST_rng(Q);
+      in.NN2[i][j] = NIST_rng(Q);
+    }
+  }
+  pk_to_A(in.pk, in.A);
+  hash_of_message(in.msg, MSG_LEN, in.h);
+  sm_to_mx(in.sm, in.smlen, in.m, &in.mlen, in.x);
+  in.shake_len = (int)ceil(M * log(Q) / log(256));
+  in.shake = malloc(in.shake_len);
+}
+
+static void b_matmul_NNN(void) { matrix_multiply(N, N, N, in.NN1, in.NN2, in.NN3); }
+static void b_matmul_NN1(void) { matrix_multiply(N, N, 1, in.NN1, in.y, in.x); }
+static void b_matmul_MN1(void) { matrix_multiply(M, N, 1, in.A, in.x, in.Ax); }
+static void b_hash(void) { hash_of_message(in.msg, MSG_LEN, in.h); }
+static void b_shake(void) { FIPS202_SHAKE256(in.msg, MSG_LEN, in.shake, in.shake_len); }
+static void b_randombytes(void) { randombytes(in.rnd, sizeof(in.rnd)); }
+static void b_nist_rng(void) { NIST_rng(Q); }
+static void b_solve_a(void) { solve_a(in.esk.C, in.esk.C1_index, in.esk.C1_value, in.esk.C1cp, in.h, in.a); }
+static void b_solve_z(void) { solve_z(in.esk.T, in.a, in.y, in.z); }
+static void b_pk_to_A(void) { pk_to_A(in.pk, in.A); }
+static void b_sm_to_mx(void) { sm_to_mx(in.sm, in.smlen, in.m, &in.mlen, in.x); }
+static void b_parse_hex(void) { ParseHex(in.sm_hex, in.sm, in.smlen); }
+static void b_sig_ver(void) { sig_ver(in.m, &in.mlen, in.sm, in.smlen, in.pk); }
+
+static void b_generate_C(void) {
+  unsigned char** C = allocate_unsigned_char_matrix_memory(M, M + D);
+  unsigned short** C1_index = allocate_unsigned_short_matrix_memory(M, NORM1);
+  unsigned char** C1_value = allocate_unsigned_char_matrix_memory(M, NORM1);
+  generate_C(C, C1_index, C1_value);
+  free_matrix(M, C);
+  free_short_matrix(M, C1_index);
+  free_matrix(M, C1_value);
+}
+
+static void b_expand_sk(void) {
+  expanded_sk esk;
+  expand_sk(in.sk, &esk);
+  free_expanded_sk(&esk);
+}
+
+static void b_sig_gen_expanded(void) {
+  unsigned long long smlen;
+  sig_gen_expanded(in.sm, &smlen, in.msg, MSG_LEN, &in.esk);
+}
+
+static void b_sig_gen(void) {
+  unsigned long long smlen;
+  sig_gen(in.sm, &smlen, in.msg, MSG_LEN, in.sk);
+}
+
+static void b_key_gen(void) {
+  unsigned char pk[CRYPTO_PUBLICKEYBYTES], sk[CRYPTO_SECRETKEYBYTES];
+  key_gen(pk, sk);
+}
+
+static const struct benchmark {
+  const char* name;
+  void (*fn)(void);
+} BENCHMARKS[] = {
+  { "matrix_multiply NxNxN", b_matmul_NNN },
+  { "matrix_multiply NxNx1", b_matmul_NN1 },
+  { "matrix_multiply MxNx1", b_matmul_MN1 },
+  { "hash_of_message", b_hash },
+  { "FIPS202_SHAKE256", b_shake },
+  { "randombytes", b_randombytes },
+  { "NIST_rng", b_nist_rng },
+  { "generate_C", b_generate_C },
+  { "solve_a", b_solve_a },
+  { "solve_z", b_solve_z },
+  { "pk_to_A", b_pk_to_A },
+  { "sm_to_mx", b_sm_to_mx },
+  { "ParseHex", b_parse_hex },
+  { "expand_sk", b_expand_sk },
+  { "sig_gen_expanded (rejection loop)", b_sig_gen_expanded },
+  { "sig_gen", b_sig_gen },
+  { "sig_ver", b_sig_ver },
+  { "key_gen", b_key_gen },
+};
+#define NUM_BENCHMARKS (sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]))
+
+struct result {
+  long calls, samples;
+  double median, mean, stddev, calls_per_sec;
+};
+
+static int by_value(const void* a, const void* b) {
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+static struct result run(void (*fn)(void), double budget) {
+  // Calibrate: enough calls per sample for a sample to take about 1 ms
+  double t0 = seconds();
+  fn();
+  double once = seconds() - t0;
+  long batch = (once > 1e-3) ? 1 : (long)(1e-3 / (once + 1e-9)) + 1;
+
+  size_t cap = 1024, n = 0;
+  double* per_call = malloc(cap * sizeof(double));
+  long calls = 0;
+  double start = seconds();
+  while (n < 3 || (seconds() - start < budget && n < 100000)) {
+    uint64_t c0 = ticks();
+    for (long i = 0; i < batch; i++) {
+      fn();
+    }
+    uint64_t c1 = ticks();
+    if (n == cap) {
+      cap *= 2;
+      per_call = realloc(per_call, cap * sizeof(double));
+    }
+    per_call[n++] = (double)(c1 - c0) / batch;
+    calls += batch;
+  }
+  double elapsed = seconds() - start;
+
+  struct result r = { .calls = calls, .samples = n };
+  for (size_t i = 0; i < n; i++) {
+    r.mean += per_call[i] / n;
+  }
+  for (size_t i = 0; i < n; i++) {
+    r.stddev += (per_call[i] - r.mean) * (per_call[i] - r.mean) / n;
+  }
+  r.stddev = sqrt(r.stddev);
+  qsort(per_call, n, sizeof(double), by_value);
+  r.median = (n % 2) ? per_call[n / 2] : (per_call[n / 2 - 1] + per_call[n / 2]) / 2;
+  r.calls_per_sec = calls / elapsed;
+  free(per_call);
+  return r;
+}
+
+// Reads the median of benchmark NAME from a JSON file written by this program. Returns -1 if it is not there.
+static double baseline_median(const char* json, const char* name) {
+  char key[128];
+  snprintf(key, sizeof(key), "\"name\": \"%s\"", name);
+  const char* p = strstr(json, key);
+  if (p == NULL || (p = strstr(p, "\"median\": ")) == NULL) {
+    return -1;
+  }
+  return atof(p + strlen("\"median\": "));
+}
+
+static char* read_file(const char* fname) {
+  FILE* f = fopen(fname, "r");
+  if (f == NULL) {
+    return NULL;
+  }
+  size_t len = 0, cap = 4096;
+  char* buf = malloc(cap);
+  size_t got;
+  while ((got = fread(buf + len, 1, cap - len - 1, f)) > 0) {
+    len += got;
+    if (cap - len - 1 == 0) {
+      cap *= 2;
+      buf = realloc(buf, cap);
+    }
+  }
+  buf[len] = 0;
+  fclose(f);
+  return buf;
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Usage: %s [-t SECONDS] [-f FILTER] [-b BASELINE.json] [-r RATIO]\n", argv0);
+}
+
+int
+main(int argc, char** argv)
+{
+  double budget = 0.5, max_ratio = 1.10;
+  const char *filter = NULL, *baseline_file = NULL;
+  char* baseline = NULL;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:f:b:r:")) != -1) {
+    switch (opt) {
+    case 't': budget = atof(optarg); break;
+    case 'f': filter = optarg; break;
+    case 'b': baseline_file = optarg; break;
+    case 'r': max_ratio = atof(optarg); break;
+    default:
+      usage(argv[0]);
+      return -1;
+    }
+  }
+  if (optind != argc) {
+    usage(argv[0]);
+    return -1;
+  }
+  if (baseline_file != NULL && (baseline = read_file(baseline_file)) == NULL) {
+    fprintf(stderr, "Couldn't open <%s> for baseline read\n", baseline_file);
+    return -1;
+  }
+
+  setup();
+
+  int regressions = 0, first = 1;
+  printf("{\n  \"algorithm\": \"%s\",\n  \"unit\": \"%s\",\n  \"benchmarks\": [", CRYPTO_ALGNAME, UNIT);
+  for (size_t i = 0; i < NUM_BENCHMARKS; i++) {
+    const struct benchmark* b = &BENCHMARKS[i];
+    if (filter != NULL && strstr(b->name, filter) == NULL) {
+      continue;
+    }
+    struct result r = run(b->fn, budget);
+    fprintf(stderr, "%-34s %14.0f %s/call %12.1f calls/s (+-%.1f%%)",
+            b->name, r.median, UNIT, r.calls_per_sec, 100 * r.stddev / r.mean);
+
+    printf("%s\n    { \"name\": \"%s\", \"calls\": %ld, \"samples\": %ld, \"median\": %.1f, \"mean\": %.1f, "
+           "\"stddev\": %.1f, \"calls_per_sec\": %.2f",
+           first ? "" : ",", b->name, r.calls, r.samples, r.median, r.mean, r.stddev, r.calls_per_sec);
+    first = 0;
+
+    double base = (baseline != NULL) ? baseline_median(baseline, b->name) : -1;
+    if (base > 0) {
+      double ratio = r.median / base;
+      int regressed = ratio > max_ratio;
+      regressions += regressed;
+      printf(", \"baseline_median\": %.1f, \"ratio\": %.3f", base, ratio);
+      fprintf(stderr, "  %.3fx baseline%s", ratio, regressed ? "  REGRESSION" : "");
+    }
+    printf(" }");
+    fprintf(stderr, "\n");
+    fflush(stdout);
+  }
+  printf("\n  ]\n}\n");
+
+  if (baseline != NULL) {
+    fprintf(stderr, "%d regression%s (slower than %.2fx baseline)\n", regressions, (regressions == 1) ? "" : "s", max_ratio);
+    free(baseline);
+  }
+  free_expanded_sk(&in.esk);
+  return regressions ? 1 : 0;
+}
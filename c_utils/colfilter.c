@@ -0,0 +1,312 @@
+// Prefilter for the candidate columns of C found by the descent, before they go
+// to partial_key_recovery.py. Every candidate takes part in the elimination at
+// each step of the column ordering, so false positives and duplicates are
+// dropped here, and the rest is sorted so that the candidates that best match
+// the structure of a column of C come first.
+//
+// For each candidate (one "[a, b, ...]" line, as written by eht_descent):
+//  - Canonicalize: of all the nonzero multiples of the vector mod Q, take the
+//    one with the smallest entries (centered around 0), ties broken by the
+//    smallest residues. Sign-flipped and other scaled copies of the same column
+//    get the same canonical form, so dropping repeated canonical forms removes
+//    exact and mod-Q duplicates.
+//  - Structure: columns of C1 have weight NORM1 with entries +-1 (see
+//    generate_C_sk). Columns of C2 get NORM2 random +-1 increments per row spread
+//    over D columns, so their entries are bounded by NORM2 and their expected
+//    weight is M * (1 - (1 - 1/D)^NORM2). Anything else is rejected.
+//  - Consistency with A: the recovery only ever looks at the candidates modulo
+//    the column span of A (through the left kernel W of A, see reduced_candidates
+//    in partial_key_recovery.py), and a candidate with W c = 0 can never be told
+//    apart from any other such candidate, so it is rejected. This is only a
+//    filter: it does not measure how consistent the other candidates are, and
+//    has no say in their order.
+//
+// The survivors are written (centered around 0) in order of their structure
+// score alone: C1 columns first, then C2 columns by how far their weight is
+// from the expected one; ties keep the input order.
+
+#define _GNU_SOURCE
+
+#include <getopt.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "api.h"
+#include "parameters.h"
+#include "general_functions.h"
+
+#include "common.h"
+#include "gf47.h"
+
+// Defined in eht_sigver.c
+void pk_to_A(const unsigned char *pk, unsigned char **A);
+
+enum verdict { KEEP, DUPLICATE, MALFORMED, ZERO, BAD_STRUCTURE, IN_SPAN_OF_A, NUM_VERDICTS };
+static const char* VERDICT_NAMES[] = { "kept", "duplicates", "malformed", "zero", "not shaped like a column of C", "in the span of A" };
+
+struct candidate {
+  uint8_t* v;     // canonical form, residues mod Q
+  double score;   // lower is more plausible
+  int index;      // position in the input
+  int verdict;
+};
+
+static int centered(int x) {
+  return (x > Q / 2) ? x - Q : x;
+}
+
+static int max_entry(const uint8_t* v) {
+  int mx = 0;
+  for (int i = 0; i < M; i++) {
+    int a = abs(centered(v[i]));
+    mx = (a > mx) ? a : mx;
+  }
+  return mx;
+}
+
+// Replaces v by its canonical multiple (see above). Returns 0 if v is zero.
+static int canonical_multiple(uint8_t* v) {
+  uint8_t best[M], tmp[M];
+  int best_max = Q;
+  for (int s = 1; s < Q; s++) {
+    for (int i = 0; i < M; i++) {
+      tmp[i] = v[i] * s % Q;
+    }
+    int mx = max_entry(tmp);
+    if (mx < best_max || (mx == best_max && memcmp(tmp, best, M) < 0)) {
+      best_max = mx;
+      memcpy(best, tmp, M);
+    }
+  }
+  memcpy(v, best, M);
+  return best_max > 0;
+}
+
+// Score by the known column structure of C, or -1 if v cannot be a column of C
+static double structure_score(const uint8_t* v) {
+  int weight = 0, mx = max_entry(v);
+  for (int i = 0; i < M; i++) {
+    weight += (v[i] != 0);
+  }
+  if (weight == NORM1 && mx == 1) {
+    return 0;
+  }
+  double expected = M * (1 - pow(1 - 1.0 / D, NORM2));
+  if (mx > NORM2 || weight < expected / 2) {
+    return -1;
+  }
+  return 1 + fabs(weight - expected) / expected;
+}
+
+// Parses "[a, b, ...]" with exactly M entries. Returns 0 on a malformed line.
+static int parse_vector(const char* s, uint8_t* v) {
+  char* end;
+  if ((s = strchr(s, '[')) == NULL) {
+    return 0;
+  }
+  s++;
+  for (int i = 0; i < M; i++) {
+    long x = strtol(s, &end, 10);
+    if (end == s) {
+      return 0;
+    }
+    v[i] = ((x % Q) + Q) % Q;
+    s = end + strspn(end, ", \t");
+  }
+  return *s == ']';
+}
+
+static uint64_t hash_vector(const uint8_t* v) {
+  // FNV-1a
+  uint64_t h = 14695981039346656037ULL;
+  for (int i = 0; i < M; i++) {
+    h = (h ^ v[i]) * 1099511628211ULL;
+  }
+  return h;
+}
+
+// Open addressing set of canonical forms. Returns 1 if v was already in it.
+static int seen_before(struct candidate** table, size_t size, struct candidate* c) {
+  size_t i = hash_vector(c->v) & (size - 1);
+  while (table[i] != NULL) {
+    if (memcmp(table[i]->v, c->v, M) == 0) {
+      return 1;
+    }
+    i = (i + 1) & (size - 1);
+  }
+  table[i] = c;
+  return 0;
+}
+
+static int by_score(const void* a, const void* b) {
+  const struct candidate* x = a;
+  const struct candidate* y = b;
+  if (x->score != y->score) {
+    return (x->score < y->score) ? -1 : 1;
+  }
+  return x->index - y->index;
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Usage: %s [-v] PUBLIC.pk < CANDIDATES > FILTERED\n", argv0);
+}
+
+int
+main(int argc, char** argv)
+{
+  int opt, verbose = 0;
+  while ((opt = getopt(argc, argv, "v")) != -1) {
+    if (opt == 'v') {
+      verbose = 1;
+    } else {
+      usage(argv[0]);
+      return -1;
+    }
+  }
+  if (optind + 1 != argc) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  unsigned char* pk;
+  if ((pk = read_pk(argv[optind])) == NULL) {
+    fprintf(stderr, "Couldn't open <%s> for public key read\n", argv[optind]);
+    return -1;
+  }
+  unsigned char** A = allocate_unsigned_char_matrix_memory(M, N);
+  if (A == NULL) {
+    fprintf(stderr, "Memory error.\n");
+    return -1;
+  }
+  pk_to_A(pk, A);
+  free(pk);
+
+  // W (M - N x M): the rows span the left kernel of A, i.e. the right kernel of A^T
+  uint8_t* At = malloc((size_t)N * M);
+  uint8_t* W = malloc((size_t)M * M);
+  for (int i = 0; i < M; i++) {
+    for (int j = 0; j < N; j++) {
+      At[(size_t)j * M + i] = A[i][j];
+    }
+  }
+  int wrows = gf47_right_kernel(At, N, M, W);
+  free(At);
+  if (wrows < 0) {
+    fprintf(stderr, "Memory error.\n");
+    return -1;
+  }
+
+  // Read all candidates
+  size_t count = 0, cap = 1024, linecap = 0;
+  struct candidate* cands = malloc(cap * sizeof(*cands));
+  char* line = NULL;
+  while (getline(&line, &linecap, stdin) > 0) {
+    if (strspn(line, " \t\r\n") == strlen(line)) {
+      continue;
+    }
+    if (count == cap) {
+      cap *= 2;
+      cands = realloc(cands, cap * sizeof(*cands));
+    }
+    struct candidate* c = &cands[count];
+    c->v = malloc(M);
+    c->index = count++;
+    c->score = 0;
+    c->verdict = parse_vector(line, c->v) ? KEEP : MALFORMED;
+  }
+  free(line);
+
+  size_t tsize = 1;
+  while (tsize < 2 * count + 1) {
+    tsize *= 2;
+  }
+  struct candidate** table = calloc(tsize, sizeof(*table));
+
+  // Canonical form, duplicates and structure; the survivors are packed into X
+  // (one row per candidate) for the test against A.
+  uint8_t* X = malloc(count * M + 1);
+  size_t nx = 0;
+  for (size_t i = 0; i < count; i++) {
+    struct candidate* c = &cands[i];
+    if (c->verdict != KEEP) {
+      continue;
+    }
+    if (!canonical_multiple(c->v)) {
+      c->verdict = ZERO;
+    } else if (seen_before(table, tsize, c)) {
+      c->verdict = DUPLICATE;
+    } else if ((c->score = structure_score(c->v)) < 0) {
+      c->verdict = BAD_STRUCTURE;
+    } else {
+      memcpy(X + nx++ * M, c->v, M);
+    }
+  }
+
+  // Rows of X W^T are the reduced candidates W c
+  uint8_t* Wt = malloc((size_t)M * wrows + 1);
+  uint8_t* XWt = malloc(nx * wrows + 1);
+  for (int i = 0; i < wrows; i++) {
+    for (int j = 0; j < M; j++) {
+      Wt[(size_t)j * wrows + i] = W[(size_t)i * M + j];
+    }
+  }
+  if (gf47_mul(X, Wt, XWt, nx, M, wrows) != 0) {
+    fprintf(stderr, "Memory error.\n");
+    return -1;
+  }
+  for (size_t i = 0, k = 0; i < count; i++) {
+    struct candidate* c = &cands[i];
+    if (c->verdict != KEEP) {
+      continue;
+    }
+    const uint8_t* r = XWt + k++ * wrows;
+    int zero = 1;
+    for (int j = 0; j < wrows && zero; j++) {
+      zero = (r[j] == 0);
+    }
+    if (zero) {
+      c->verdict = IN_SPAN_OF_A;
+    }
+  }
+
+  // Write the survivors in ranked order
+  qsort(cands, count, sizeof(*cands), by_score);
+  size_t tally[NUM_VERDICTS] = { 0 };
+  for (size_t i = 0; i < count; i++) {
+    struct candidate* c = &cands[i];
+    tally[c->verdict]++;
+    if (c->verdict != KEEP) {
+      continue;
+    }
+    printf("[");
+    for (int j = 0; j < M; j++) {
+      printf((j < M - 1) ? "%d, " : "%d]\n", centered(c->v[j]));
+    }
+    if (verbose) {
+      fprintf(stderr, "input line %d: score %.3f\n", c->index + 1, c->score);
+    }
+  }
+
+  fprintf(stderr, "%zu candidates:", count);
+  for (int i = 0; i < NUM_VERDICTS; i++) {
+    fprintf(stderr, "%s %zu %s", (i == 0) ? "" : ",", tally[i], VERDICT_NAMES[i]);
+  }
+  fprintf(stderr, "\n");
+  report_metric("candidate_columns", count);
+  report_metric("kept_columns", tally[KEEP]);
+
+  for (size_t i = 0; i < count; i++) {
+    free(cands[i].v);
+  }
+  free(cands);
+  free(table);
+  free(X);
+  free(Wt);
+  free(XWt);
+  free(W);
+  return 0;
+}
@@ -114,16 +114,39 @@ ParseHex(char *inbuf, unsigned char *A, int Length)
 
 void fprintMat(FILE *fp, const char* name, unsigned char **M, int nrows, int ncols) {
   //fprintf(fp, "%s = [\n", name);
+  // Each row is formatted into one buffer (at most 5 characters per entry plus the
+  // brackets), instead of one fprintf per entry
+  char* buf = malloc(5 * (size_t)ncols + 8);
   fprintf(fp, "[\n");
   for (unsigned int i = 0; i < nrows; i++) {
-    fprintf(fp, "[");
+    char* p = buf;
+    *p++ = '[';
     for (unsigned int j = 0; j < ncols; j++) {
-      fprintf(fp, "%d", M[i][j]);
+      unsigned char x = M[i][j];
+      if (x >= 100) {
+        *p++ = '0' + x / 100;
+      }
+      if (x >= 10) {
+        *p++ = '0' + x / 10 % 10;
+      }
+      *p++ = '0' + x % 10;
       if (j < ncols - 1) {
-	fprintf(fp, ", ");
+        *p++ = ',';
+        *p++ = ' ';
       }
     }
-    fprintf(fp, (i < nrows - 1) ? "],\n": "]\n");
+    strcpy(p, (i < nrows - 1) ? "],\n": "]\n");
+    fputs(buf, fp);
   }
   fprintf(fp, "]\n");
+  free(buf);
+}
+
+// Prints "METRIC NAME VALUE" to stderr when EHT_METRICS is set, for run_pipeline.py
+// (see metrics.py). Values are counts, which run_pipeline.py adds up per stage.
+void report_metric(const char* name, double value) {
+  if (getenv("EHT_METRICS") == NULL || *getenv("EHT_METRICS") == '\0') {
+    return;
+  }
+  fprintf(stderr, "METRIC %s %.17g\n", name, value);
 }
@@ -11,4 +11,6 @@ void	fprintBstr(FILE *fp, char *S, unsigned char *A, unsigned long long L);
 
 void fprintMat(FILE *fp, const char* name, unsigned char **M, int nrows, int ncols);
 
+void report_metric(const char* name, double value);
+
 #endif
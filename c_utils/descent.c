@@ -0,0 +1,847 @@
+// Native version of descent.py: runs many gradient descents over the morphed
+// vectors written by morph.py and writes the distinct recovered columns of C.
+//
+// All runs share one in-memory copy of the dataset. The dataset is split into
+// chunks that are first touched by the (pinned) worker threads in round-robin
+// order, so on NUMA machines the pages end up spread over all memory nodes
+// instead of all sitting on the node that happened to read the file.
+// Recovered vectors are sign-normalized like in descent_loop, deduplicated in a
+// concurrent hash set, and appended to the output file as soon as they are found.
+//
+// With -c, the runner is a worker for coordinator.py instead: it gets its seed
+// and batches of run indices from the coordinator, reports the vectors it
+// finds, learns the vectors found by all other workers, and stops as soon as
+// the coordinator says so (or finishes its last runs once the coordinator has
+// none left to hand out). The protocol is line-based text, see coordinator.py.
+
+#define _GNU_SOURCE
+
+#include <getopt.h>
+#include <math.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "npy.h"
+
+#define CHUNK_ROWS 4096
+#define MAXITERS 10000
+
+enum update_rule { UPDATE_GRADIENT, UPDATE_FIXEDPOINT, UPDATE_LINESEARCH };
+static const char* UPDATE_NAMES[] = { "gradient", "fixedpoint", "linesearch" };
+
+// Storage types for the morphed vectors, see STORAGE_DTYPES in morph.py.
+// Whatever the storage type, all moments are accumulated in double precision.
+enum storage { STORAGE_F64, STORAGE_F32, STORAGE_BF16 };
+static const char* STORAGE_DESCRS[] = { "<f8", "<f4", "<u2" };
+static const size_t STORAGE_SIZES[] = { 8, 4, 2 };
+
+typedef struct {
+  long nrows;
+  int dim;
+  enum storage type;
+  void* vecs;     // nrows x dim, row-major
+  double* Li;     // dim x dim, row-major
+} dataset;
+
+static float bf16_to_float(uint16_t b) {
+  uint32_t bits = (uint32_t)b << 16;
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+// Returns row r of the dataset as doubles, converting into buf if needed
+static const double* get_row(const dataset* ds, long r, double* buf) {
+  int n = ds->dim;
+  if (ds->type == STORAGE_F64) {
+    return (const double*)ds->vecs + r * n;
+  } else if (ds->type == STORAGE_F32) {
+    const float* x = (const float*)ds->vecs + r * n;
+    for (int i = 0; i < n; i++) {
+      buf[i] = x[i];
+    }
+  } else {
+    const uint16_t* x = (const uint16_t*)ds->vecs + r * n;
+    for (int i = 0; i < n; i++) {
+      buf[i] = bf16_to_float(x[i]);
+    }
+  }
+  return buf;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Concurrent set of integer vectors
+
+#define SET_BUCKETS 4096
+#define SET_STRIPES 64
+
+typedef struct set_node {
+  uint64_t hash;
+  struct set_node* next;
+  int v[];
+} set_node;
+
+typedef struct {
+  int dim;
+  long size;
+  set_node* buckets[SET_BUCKETS];
+  pthread_mutex_t locks[SET_STRIPES];
+} vecset;
+
+static void vecset_init(vecset* s, int dim) {
+  memset(s, 0, sizeof(*s));
+  s->dim = dim;
+  for (int i = 0; i < SET_STRIPES; i++) {
+    pthread_mutex_init(&s->locks[i], NULL);
+  }
+}
+
+static uint64_t vec_hash(const int* v, int dim) {
+  // FNV-1a over the coefficients
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (int i = 0; i < dim; i++) {
+    h ^= (uint32_t)v[i];
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+// Returns 1 if v was not in the set yet.
+static int vecset_insert(vecset* s, const int* v) {
+  uint64_t h = vec_hash(v, s->dim);
+  size_t b = h % SET_BUCKETS;
+  pthread_mutex_t* lock = &s->locks[b % SET_STRIPES];
+
+  pthread_mutex_lock(lock);
+  for (set_node* n = s->buckets[b]; n != NULL; n = n->next) {
+    if (n->hash == h && memcmp(n->v, v, s->dim * sizeof(int)) == 0) {
+      pthread_mutex_unlock(lock);
+      return 0;
+    }
+  }
+  set_node* n = malloc(sizeof(set_node) + s->dim * sizeof(int));
+  n->hash = h;
+  memcpy(n->v, v, s->dim * sizeof(int));
+  n->next = s->buckets[b];
+  s->buckets[b] = n;
+  __sync_fetch_and_add(&s->size, 1);
+  pthread_mutex_unlock(lock);
+  return 1;
+}
+
+static int vecset_contains(vecset* s, const int* v) {
+  uint64_t h = vec_hash(v, s->dim);
+  size_t b = h % SET_BUCKETS;
+  pthread_mutex_t* lock = &s->locks[b % SET_STRIPES];
+  int found = 0;
+
+  pthread_mutex_lock(lock);
+  for (set_node* n = s->buckets[b]; n != NULL && !found; n = n->next) {
+    found = n->hash == h && memcmp(n->v, v, s->dim * sizeof(int)) == 0;
+  }
+  pthread_mutex_unlock(lock);
+  return found;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Random starting points
+
+// splitmix64, used both to derive per-run seeds and as the generator itself
+static uint64_t splitmix64(uint64_t* x) {
+  uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static double uniform01(uint64_t* x) {
+  return ((splitmix64(x) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+// The starting point of a run only depends on (seed, run), not on which thread executes it
+static void random_unit_vector(uint64_t seed, long run, double* w, int dim) {
+  uint64_t x = seed ^ (0xd1b54a32d192ed03ULL * (uint64_t)(run + 1));
+  double norm = 0;
+  for (int i = 0; i < dim; i++) {
+    // Box-Muller
+    double u1 = uniform01(&x), u2 = uniform01(&x);
+    w[i] = sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+    norm += w[i] * w[i];
+  }
+  norm = sqrt(norm);
+  for (int i = 0; i < dim; i++) {
+    w[i] /= norm;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////
+// Descent
+
+static double dot(const double* x, const double* y, int n) {
+  // Independent accumulators, since the compiler may not reassociate the sum itself
+  double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    s0 += x[i] * y[i];
+    s1 += x[i+1] * y[i+1];
+    s2 += x[i+2] * y[i+2];
+    s3 += x[i+3] * y[i+3];
+  }
+  for (; i < n; i++) {
+    s0 += x[i] * y[i];
+  }
+  return (s0 + s1) + (s2 + s3);
+}
+
+static double norm(const double* x, int n) {
+  return sqrt(dot(x, x, n));
+}
+
+// mom2 = E[<x,w>^2], mom4 = E[<x,w>^4], grad = grad_w mom4 = 4 E[x <x,w>^3]
+// buf is scratch space for one row.
+static void moments(const dataset* ds, const double* w, double* mom2, double* mom4, double* grad, double* buf) {
+  int n = ds->dim;
+  double s2 = 0, s4 = 0;
+  memset(grad, 0, n * sizeof(double));
+  for (long r = 0; r < ds->nrows; r++) {
+    const double* x = get_row(ds, r, buf);
+    double t = dot(x, w, n);
+    double t2 = t * t;
+    double t3 = t2 * t;
+    s2 += t2;
+    s4 += t2 * t2;
+    for (int i = 0; i < n; i++) {
+      grad[i] += t3 * x[i];
+    }
+  }
+  *mom2 = s2 / ds->nrows;
+  *mom4 = s4 / ds->nrows;
+  for (int i = 0; i < n; i++) {
+    grad[i] *= 4.0 / ds->nrows;
+  }
+}
+
+// Turns a minimum w of mom4 into a candidate column of C, as in descent_loop.
+// Returns 0 for the zero vector.
+static int recover_vector(const dataset* ds, const double* w, double m, int* out) {
+  int n = ds->dim;
+  double gamma = (m < 1. / 3) ? sqrt(sqrt((1. / 3 - m) * 15 / 2)) : 1;
+  int nonzero = 0, flip = 0;
+  for (int i = 0; i < n; i++) {
+    // nearbyint rounds half to even, like Python's round()
+    out[i] = (int)nearbyint(gamma * dot(ds->Li + (long)i * n, w, n));
+    if (out[i] != 0 && !nonzero) {
+      nonzero = 1;
+      flip = out[i] < 0; // makes deduplication easier
+    }
+  }
+  if (flip) {
+    for (int i = 0; i < n; i++) {
+      out[i] = -out[i];
+    }
+  }
+  return nonzero;
+}
+
+typedef struct {
+  const dataset* ds;
+  enum update_rule rule;
+  double delta;
+  vecset* known;            // vectors that have been found already, or NULL to never abandon a run
+  volatile int* stop;       // set when all runs should be abandoned
+  double *wnew, *gm, *gmnew, *gt, *row;   // scratch space
+  int* v;
+} descent_ctx;
+
+enum descent_status { DESCENT_CONVERGED, DESCENT_KNOWN, DESCENT_STOPPED };
+
+// Checked after every iteration. A run is abandoned once the vector it would
+// recover has been a known vector for two iterations in a row, since by then
+// it is almost certainly converging to that vector.
+static int should_abandon(descent_ctx* ctx, const double* w, double m, int* hits, enum descent_status* status) {
+  if (*ctx->stop) {
+    *status = DESCENT_STOPPED;
+    return 1;
+  }
+  if (ctx->known != NULL && ctx->known->size > 0 && recover_vector(ctx->ds, w, m, ctx->v) && vecset_contains(ctx->known, ctx->v)) {
+    if (++*hits >= 2) {
+      *status = DESCENT_KNOWN;
+      return 1;
+    }
+  } else {
+    *hits = 0;
+  }
+  return 0;
+}
+
+// Same update rules as descent.py. Overwrites w with the minimum found and returns
+// mom4 there; *iters is the number of moment evaluations (passes over the data).
+static double descend(descent_ctx* ctx, double* w, int* iters, enum descent_status* status) {
+  const dataset* ds = ctx->ds;
+  int n = ds->dim;
+  double *wnew = ctx->wnew, *gm = ctx->gm, *gmnew = ctx->gmnew, *gt = ctx->gt;
+  double m2, m, m2new, mnew;
+  double step = ctx->delta;
+  int hits = 0;
+
+  *status = DESCENT_CONVERGED;
+  moments(ds, w, &m2, &m, gm, ctx->row);
+  *iters = 1;
+  while (*iters < MAXITERS) {
+    if (ctx->rule == UPDATE_GRADIENT) {
+      // Plain gradient descent with a fixed step size (Algorithm 2)
+      for (int i = 0; i < n; i++) {
+        wnew[i] = w[i] - ctx->delta * gm[i];
+      }
+      double nn = norm(wnew, n);
+      for (int i = 0; i < n; i++) {
+        wnew[i] /= nn;
+      }
+      moments(ds, wnew, &m2new, &mnew, gmnew, ctx->row);
+      (*iters)++;
+      if (m - mnew < .00001) {
+        break;
+      }
+    } else if (ctx->rule == UPDATE_FIXEDPOINT) {
+      // FastICA-style fixed-point iteration w <- E[x <x,w>^3] - 3 E[<x,w>^2]^2 w
+      for (int i = 0; i < n; i++) {
+        wnew[i] = gm[i] / 4 - 3 * m2 * m2 * w[i];
+      }
+      double nn = norm(wnew, n);
+      if (dot(wnew, w, n) < 0) {
+        nn = -nn;
+      }
+      for (int i = 0; i < n; i++) {
+        wnew[i] /= nn;
+      }
+      moments(ds, wnew, &m2new, &mnew, gmnew, ctx->row);
+      (*iters)++;
+      int converged = 1 - dot(wnew, w, n) < 1e-8;
+      memcpy(w, wnew, n * sizeof(double));
+      m2 = m2new;
+      m = mnew;
+      memcpy(gm, gmnew, n * sizeof(double));
+      if (converged || should_abandon(ctx, w, m, &hits, status)) {
+        break;
+      }
+      continue;
+    } else {
+      // Gradient descent with a backtracking (Armijo) line search
+      double gw = dot(gm, w, n);
+      for (int i = 0; i < n; i++) {
+        gt[i] = gm[i] - gw * w[i];
+      }
+      double gtgt = dot(gt, gt, n);
+      while (*iters < MAXITERS) {
+        for (int i = 0; i < n; i++) {
+          wnew[i] = w[i] - step * gt[i];
+        }
+        double nn = norm(wnew, n);
+        for (int i = 0; i < n; i++) {
+          wnew[i] /= nn;
+        }
+        moments(ds, wnew, &m2new, &mnew, gmnew, ctx->row);
+        (*iters)++;
+        if (mnew <= m - 1e-4 * step * gtgt || step < 1e-6) {
+          break;
+        }
+        step /= 2;
+      }
+      if (m - mnew < .00001) {
+        break;
+      }
+      step *= 2;
+    }
+    memcpy(w, wnew, n * sizeof(double));
+    m2 = m2new;
+    m = mnew;
+    memcpy(gm, gmnew, n * sizeof(double));
+    if (should_abandon(ctx, w, m, &hits, status)) {
+      break;
+    }
+  }
+  return m;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Thread pool
+
+typedef struct {
+  dataset* ds;
+  npy_array* src;
+  enum update_rule rule;
+  double delta;
+  uint64_t seed;
+  long nruns;
+  int nthreads;
+  int abandon;              // abandon runs that converge to a vector that was already found
+
+  long next_run;
+  long runs_done;
+  long runs_abandoned;
+  long total_iters;
+  volatile int stop;
+  vecset found;
+
+  // Only used with -V: every run is repeated on the float64 dataset ref
+  const dataset* ref;
+  long compared;
+  long mismatches;
+
+  FILE* out;
+  pthread_mutex_t out_lock;
+  pthread_barrier_t loaded;
+
+  // Only used when running as a worker for coordinator.py
+  FILE* conn_in;
+  FILE* conn_out;
+  pthread_mutex_t conn_lock;
+  pthread_cond_t batch_ready;
+  long batch_next, batch_end;
+  int batch_requested;
+  int no_more;                  // the coordinator has handed out all runs
+} runner;
+
+typedef struct {
+  runner* r;
+  int id;
+} worker_arg;
+
+static void pin_to_cpu(int id) {
+  long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(id % ncpus, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+static void write_vector(FILE* fp, const int* v, int n) {
+  fprintf(fp, "[");
+  for (int i = 0; i < n; i++) {
+    fprintf(fp, (i < n - 1) ? "%d, " : "%d", v[i]);
+  }
+  fprintf(fp, "]\n");
+  fflush(fp);
+}
+
+// Parses "[a, b, ...]" as written by write_vector. Returns 0 on a malformed line.
+static int parse_vector(const char* s, int* v, int n) {
+  char* end;
+  if ((s = strchr(s, '[')) == NULL) {
+    return 0;
+  }
+  s++;
+  for (int i = 0; i < n; i++) {
+    v[i] = strtol(s, &end, 10);
+    if (end == s) {
+      return 0;
+    }
+    s = end + strspn(end, ", ");
+  }
+  return *s == ']';
+}
+
+// Returns the next run to do, or -1 once all runs are done or the runner was stopped.
+// As a worker, runs come in batches from the coordinator; the next batch is requested
+// as soon as the last run of the current one is handed out, until the coordinator
+// answers NOMORE.
+static long next_run(runner* r) {
+  if (r->conn_out == NULL) {
+    long run = __sync_fetch_and_add(&r->next_run, 1);
+    return (run < r->nruns && !r->stop) ? run : -1;
+  }
+  long run = -1;
+  pthread_mutex_lock(&r->conn_lock);
+  while (!r->stop) {
+    if (r->batch_next < r->batch_end) {
+      run = r->batch_next++;
+    }
+    if (r->batch_next >= r->batch_end && !r->batch_requested && !r->no_more) {
+      fprintf(r->conn_out, "MORE\n");
+      fflush(r->conn_out);
+      r->batch_requested = 1;
+    }
+    if (run >= 0 || r->no_more) {
+      break;
+    }
+    pthread_cond_wait(&r->batch_ready, &r->conn_lock);
+  }
+  pthread_mutex_unlock(&r->conn_lock);
+  return run;
+}
+
+// Handles the messages from the coordinator until it sends STOP or goes away (which it
+// does once this worker hangs up after NOMORE).
+static void* receiver(void* p) {
+  runner* r = p;
+  int n = r->ds->dim;
+  int* v = malloc(n * sizeof(int));
+  char* line = NULL;
+  size_t cap = 0;
+  long start, count;
+
+  while (getline(&line, &cap, r->conn_in) > 0) {
+    if (sscanf(line, "SEEDS %ld %ld", &start, &count) == 2) {
+      pthread_mutex_lock(&r->conn_lock);
+      r->batch_next = start;
+      r->batch_end = start + count;
+      r->batch_requested = 0;
+      pthread_cond_broadcast(&r->batch_ready);
+      pthread_mutex_unlock(&r->conn_lock);
+    } else if (strncmp(line, "KNOWN ", 6) == 0) {
+      // Found by another worker; this one no longer needs to report it
+      if (parse_vector(line + 6, v, n)) {
+        vecset_insert(&r->found, v);
+      }
+    } else if (strncmp(line, "NOMORE", 6) == 0) {
+      // The runs in progress still count, so let them finish
+      pthread_mutex_lock(&r->conn_lock);
+      r->no_more = 1;
+      pthread_cond_broadcast(&r->batch_ready);
+      pthread_mutex_unlock(&r->conn_lock);
+    } else if (strncmp(line, "STOP", 4) == 0) {
+      break;
+    } else {
+      fprintf(stderr, "Ignoring unexpected message from coordinator: %s", line);
+    }
+  }
+
+  pthread_mutex_lock(&r->conn_lock);
+  r->stop = 1;
+  pthread_cond_broadcast(&r->batch_ready);
+  pthread_mutex_unlock(&r->conn_lock);
+  free(line);
+  free(v);
+  return NULL;
+}
+
+static void* worker(void* p) {
+  worker_arg* arg = p;
+  runner* r = arg->r;
+  dataset* ds = r->ds;
+  int n = ds->dim;
+
+  pin_to_cpu(arg->id);
+
+  // First touch: every thread copies its share of the chunks into the shared buffer
+  long nchunks = (ds->nrows + CHUNK_ROWS - 1) / CHUNK_ROWS;
+  for (long c = arg->id; c < nchunks; c += r->nthreads) {
+    long start = c * CHUNK_ROWS;
+    long rows = (start + CHUNK_ROWS <= ds->nrows) ? CHUNK_ROWS : ds->nrows - start;
+    size_t rowsize = n * STORAGE_SIZES[ds->type];
+    memcpy((char*)ds->vecs + start * rowsize, (const char*)r->src->data + start * rowsize, rows * rowsize);
+  }
+  // Once every thread has copied its chunks, one of them drops the mapping of the file,
+  // so that the dataset is only resident once while the runs go on
+  if (pthread_barrier_wait(&r->loaded) == PTHREAD_BARRIER_SERIAL_THREAD) {
+    npy_unmap(r->src);
+  }
+
+  double* w = malloc(8 * n * sizeof(double));
+  int* v = malloc(2 * n * sizeof(int));
+  // Abandoning runs near known vectors would make validation compare different things
+  vecset* known = (r->abandon && r->ref == NULL) ? &r->found : NULL;
+  descent_ctx ctx = { ds, r->rule, r->delta, known, &r->stop, w + n, w + 2*n, w + 3*n, w + 4*n, w + 5*n, v };
+  descent_ctx refctx = ctx;
+  refctx.ds = r->ref;
+  double* wref = w + 6*n;
+
+  long run;
+  while ((run = next_run(r)) >= 0) {
+    int iters;
+    enum descent_status status;
+    random_unit_vector(r->seed, run, w, n);
+    memcpy(wref, w, n * sizeof(double));
+    double m = descend(&ctx, w, &iters, &status);
+    __sync_fetch_and_add(&r->total_iters, iters);
+    if (r->ref != NULL && status == DESCENT_CONVERGED) {
+      int refiters;
+      double mref = descend(&refctx, wref, &refiters, &status);
+      int ok = recover_vector(ds, w, m, v) == recover_vector(r->ref, wref, mref, v + n)
+               && memcmp(v, v + n, n * sizeof(int)) == 0;
+      __sync_fetch_and_add(&r->compared, 1);
+      if (!ok) {
+        __sync_fetch_and_add(&r->mismatches, 1);
+      }
+      fprintf(stderr, "run %ld: %d iterations, float64 reference %d iterations, %s\n",
+              run, iters, refiters, ok ? "same vector" : "DIFFERENT vector");
+    }
+    if (status == DESCENT_STOPPED) {
+      break;
+    }
+    __sync_fetch_and_add(&r->runs_done, 1);
+    if (status == DESCENT_KNOWN) {
+      __sync_fetch_and_add(&r->runs_abandoned, 1);
+      fprintf(stderr, "run %ld: %d iterations, abandoned near a known vector\n", run, iters);
+      continue;
+    }
+
+    if (!recover_vector(ds, w, m, v)) {
+      fprintf(stderr, "run %ld: %d iterations, zero vector\n", run, iters);
+      continue;
+    }
+    int fresh = vecset_insert(&r->found, v);
+    fprintf(stderr, "run %ld: %d iterations, %s vector (%ld distinct)\n", run, iters, fresh ? "new" : "duplicate", r->found.size);
+    if (fresh) {
+      pthread_mutex_lock(&r->out_lock);
+      write_vector(r->out, v, n);
+      pthread_mutex_unlock(&r->out_lock);
+      if (r->conn_out != NULL) {
+        pthread_mutex_lock(&r->conn_lock);
+        fprintf(r->conn_out, "VEC %ld ", run);
+        write_vector(r->conn_out, v, n);
+        pthread_mutex_unlock(&r->conn_lock);
+      }
+    }
+  }
+
+  free(v);
+  free(w);
+  return NULL;
+}
+
+// ADDRESS is either HOST:PORT or unix:PATH. Returns a connected socket, or -1.
+static int connect_to(const char* address) {
+  if (strncmp(address, "unix:", 5) == 0) {
+    struct sockaddr_un sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strncpy(sa.sun_path, address + 5, sizeof(sa.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr*)&sa, sizeof(sa)) != 0) {
+      close(fd);
+      fd = -1;
+    }
+    return fd;
+  }
+
+  char host[256];
+  const char* port = strrchr(address, ':');
+  if (port == NULL || port - address >= (long)sizeof(host)) {
+    return -1;
+  }
+  memcpy(host, address, port - address);
+  host[port - address] = '\0';
+
+  struct addrinfo hints, *res;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(host, port + 1, &hints, &res) != 0) {
+    return -1;
+  }
+  int fd = -1;
+  for (struct addrinfo* ai = res; ai != NULL && fd < 0; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(res);
+  return fd;
+}
+
+// Says hello and waits for the seed all workers share.
+static int join_coordinator(runner* r, const char* address) {
+  int fd = connect_to(address);
+  if (fd < 0) {
+    return -1;
+  }
+  r->conn_in = fdopen(fd, "r");
+  r->conn_out = fdopen(dup(fd), "w");
+  if (r->conn_in == NULL || r->conn_out == NULL) {
+    return -1;
+  }
+
+  char host[256] = "worker";
+  gethostname(host, sizeof(host));
+  host[sizeof(host) - 1] = '\0';
+  fprintf(r->conn_out, "HELLO %s:%d %d\n", host, (int)getpid(), r->nthreads);
+  fflush(r->conn_out);
+
+  char line[256];
+  unsigned long long seed;
+  if (fgets(line, sizeof(line), r->conn_in) == NULL || sscanf(line, "SEED %llu", &seed) != 1) {
+    return -1;
+  }
+  r->seed = seed;
+  pthread_mutex_init(&r->conn_lock, NULL);
+  pthread_cond_init(&r->batch_ready, NULL);
+  return 0;
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Usage: %s [-t THREADS] [-n RUNS] [-s SEED] [-u gradient|fixedpoint|linesearch] [-d DELTA] [-a] [-c ADDRESS] [-V REFFILE] INFILE OUTFILE\n", argv0);
+  fprintf(stderr, "  Reads INFILE.Li.npy and INFILE.vecs.npy (written by morph.py, stored as float64,\n");
+  fprintf(stderr, "  float32 or bfloat16) and writes the distinct recovered vectors to OUTFILE, one per line.\n");
+  fprintf(stderr, "  With -V, every run is repeated from the same starting point on REFFILE.vecs.npy,\n");
+  fprintf(stderr, "  the float64 version of the same data, and the recovered vectors are compared.\n");
+  fprintf(stderr, "  With -a, runs that are converging to a vector that was already found are abandoned.\n");
+  fprintf(stderr, "  With -c HOST:PORT or -c unix:PATH, works for coordinator.py instead of doing\n");
+  fprintf(stderr, "  RUNS runs itself (always with -a); OUTFILE then only gets the vectors this worker\n");
+  fprintf(stderr, "  found first.\n");
+}
+
+int
+main(int argc, char** argv)
+{
+  runner r;
+  memset(&r, 0, sizeof(r));
+  r.nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+  r.nruns = 1;
+  r.rule = UPDATE_GRADIENT;
+  r.delta = 0.7;
+  const char* coordinator = NULL;
+  const char* reffile = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "t:n:s:u:d:ac:V:")) != -1) {
+    switch (opt) {
+    case 't': r.nthreads = atoi(optarg); break;
+    case 'n': r.nruns = atol(optarg); break;
+    case 's': r.seed = strtoull(optarg, NULL, 0); break;
+    case 'd': r.delta = atof(optarg); break;
+    case 'a': r.abandon = 1; break;
+    case 'c': coordinator = optarg; r.abandon = 1; break;
+    case 'V': reffile = optarg; break;
+    case 'u':
+      for (r.rule = 0; r.rule < 3 && strcmp(optarg, UPDATE_NAMES[r.rule]) != 0; r.rule++);
+      if (r.rule == 3) {
+        usage(argv[0]);
+        return -1;
+      }
+      break;
+    default:
+      usage(argv[0]);
+      return -1;
+    }
+  }
+  if (argc - optind != 2 || r.nthreads < 1) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  char fname[4096];
+  npy_array Li, vecs;
+  snprintf(fname, sizeof(fname), "%s.Li.npy", argv[optind]);
+  if (npy_map(fname, &Li) != 0 || strcmp(Li.descr, "<f8") != 0) {
+    fprintf(stderr, "Couldn't read <%s> as a float64 .npy file\n", fname);
+    return -1;
+  }
+  snprintf(fname, sizeof(fname), "%s.vecs.npy", argv[optind]);
+  enum storage type = STORAGE_F64;
+  if (npy_map(fname, &vecs) == 0) {
+    while (type <= STORAGE_BF16 && strcmp(vecs.descr, STORAGE_DESCRS[type]) != 0) {
+      type++;
+    }
+  }
+  if (vecs.map == NULL || type > STORAGE_BF16 || vecs.ndim != 2 || vecs.shape[1] != Li.shape[0]) {
+    fprintf(stderr, "Couldn't read <%s> as a float64, float32 or bfloat16 .npy file matching the .Li.npy file\n", fname);
+    return -1;
+  }
+  if ((r.out = fopen(argv[optind + 1], "w")) == NULL) {
+    fprintf(stderr, "Couldn't open <%s> for write\n", argv[optind + 1]);
+    return -1;
+  }
+
+  dataset ds;
+  ds.nrows = vecs.shape[0];
+  ds.dim = vecs.shape[1];
+  ds.type = type;
+  ds.Li = malloc(ds.dim * ds.dim * sizeof(double));
+  memcpy(ds.Li, Li.data, ds.dim * ds.dim * sizeof(double));
+  npy_unmap(&Li);
+  // Not touched here, so that the workers decide where its pages live
+  ds.vecs = malloc(ds.nrows * ds.dim * STORAGE_SIZES[type]);
+  if (ds.Li == NULL || ds.vecs == NULL) {
+    fprintf(stderr, "Memory error.\n");
+    return -1;
+  }
+
+  r.ds = &ds;
+  r.src = &vecs;
+
+  // The reference dataset is only read from its mapping; validation runs need not be fast
+  dataset ref;
+  npy_array refvecs;
+  if (reffile != NULL) {
+    snprintf(fname, sizeof(fname), "%s.vecs.npy", reffile);
+    if (npy_map(fname, &refvecs) != 0 || strcmp(refvecs.descr, "<f8") != 0 || refvecs.shape[0] != vecs.shape[0] || refvecs.shape[1] != vecs.shape[1]) {
+      fprintf(stderr, "Couldn't read <%s> as a float64 .npy file of the same shape as <%s.vecs.npy>\n", fname, argv[optind]);
+      return -1;
+    }
+    ref = ds;
+    ref.type = STORAGE_F64;
+    ref.vecs = (void*)refvecs.data;
+    r.ref = &ref;
+  }
+  vecset_init(&r.found, ds.dim);
+  pthread_mutex_init(&r.out_lock, NULL);
+  pthread_barrier_init(&r.loaded, NULL, r.nthreads);
+
+  pthread_t recv_thread;
+  if (coordinator != NULL) {
+    // The coordinator may hang up on us at any time
+    signal(SIGPIPE, SIG_IGN);
+    if (join_coordinator(&r, coordinator) != 0) {
+      fprintf(stderr, "Couldn't join the coordinator at <%s>\n", coordinator);
+      return -1;
+    }
+    pthread_create(&recv_thread, NULL, receiver, &r);
+    fprintf(stderr, "Running descents (%s) for the coordinator at %s on %ld vectors of dimension %d with %d threads\n",
+            UPDATE_NAMES[r.rule], coordinator, ds.nrows, ds.dim, r.nthreads);
+  } else {
+    fprintf(stderr, "Running %ld descents (%s) on %ld vectors (%s) of dimension %d with %d threads\n",
+            r.nruns, UPDATE_NAMES[r.rule], ds.nrows, STORAGE_DESCRS[type], ds.dim, r.nthreads);
+  }
+
+  pthread_t* threads = malloc(r.nthreads * sizeof(pthread_t));
+  worker_arg* args = malloc(r.nthreads * sizeof(worker_arg));
+  for (int i = 0; i < r.nthreads; i++) {
+    args[i].r = &r;
+    args[i].id = i;
+    pthread_create(&threads[i], NULL, worker, &args[i]);
+  }
+  for (int i = 0; i < r.nthreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  if (coordinator != NULL) {
+    // The workers return after STOP, or after NOMORE once their last runs are done. Hang up,
+    // so that the coordinator knows these runs are done and closes the connection, which
+    // ends the receiver.
+    fflush(r.conn_out);
+    shutdown(fileno(r.conn_out), SHUT_WR);
+    pthread_join(recv_thread, NULL);
+    fclose(r.conn_out);
+    fclose(r.conn_in);
+  }
+  fclose(r.out);
+
+  if (reffile != NULL) {
+    npy_unmap(&refvecs);
+    fprintf(stderr, "Validation: %ld of %ld runs recovered the same vector as on the float64 data\n",
+            r.compared - r.mismatches, r.compared);
+  }
+  fprintf(stderr, "Finished %ld descents (%ld abandoned near known vectors), %ld iterations, %.1f per run; %ld distinct vectors\n",
+          r.runs_done, r.runs_abandoned, r.total_iters, (double)r.total_iters / (r.runs_done ? r.runs_done : 1), r.found.size);
+  report_metric("descent_runs", r.runs_done);
+  report_metric("descent_iterations", r.total_iters);
+  report_metric("distinct_vectors", r.found.size);
+
+  free(args);
+  free(threads);
+  free(ds.vecs);
+  free(ds.Li);
+  return 0;
+}
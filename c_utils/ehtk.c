@@ -0,0 +1,143 @@
+// See ehtk.h.
+
+#define _DEFAULT_SOURCE
+
+#include "ehtk.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define HEADER_SIZE 12
+#define ENTRY_SIZE (EHTK_NAMELEN + 16)
+
+struct ehtk {
+  const uint8_t* data;
+  size_t size;
+  uint32_t count;
+};
+
+static void put_u32(uint8_t* p, uint32_t x) {
+  for (int i = 0; i < 4; i++) {
+    p[i] = x >> (8 * i);
+  }
+}
+
+static void put_u64(uint8_t* p, uint64_t x) {
+  for (int i = 0; i < 8; i++) {
+    p[i] = x >> (8 * i);
+  }
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+  return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t get_u64(const uint8_t* p) {
+  return get_u32(p) | (uint64_t)get_u32(p + 4) << 32;
+}
+
+static uint64_t align(uint64_t x) {
+  return (x + EHTK_ALIGN - 1) / EHTK_ALIGN * EHTK_ALIGN;
+}
+
+int ehtk_write(const char* fname, int count, const char* const* names,
+               const int* rows, const int* cols, unsigned char*** mats) {
+  FILE* fp = fopen(fname, "wb");
+  if (fp == NULL) {
+    return -1;
+  }
+
+  uint64_t header_size = align(HEADER_SIZE + (uint64_t)count * ENTRY_SIZE);
+  uint8_t* header = calloc(header_size, 1);
+  memcpy(header, EHTK_MAGIC, 4);
+  put_u32(header + 4, EHTK_VERSION);
+  put_u32(header + 8, count);
+  uint64_t offset = header_size;
+  for (int k = 0; k < count; k++) {
+    uint8_t* e = header + HEADER_SIZE + k * ENTRY_SIZE;
+    strncpy((char*)e, names[k], EHTK_NAMELEN);
+    put_u32(e + EHTK_NAMELEN, rows[k]);
+    put_u32(e + EHTK_NAMELEN + 4, cols[k]);
+    put_u64(e + EHTK_NAMELEN + 8, offset);
+    offset = align(offset + (uint64_t)rows[k] * cols[k]);
+  }
+  int ok = fwrite(header, 1, header_size, fp) == header_size;
+  free(header);
+
+  static const uint8_t zeros[EHTK_ALIGN];
+  for (int k = 0; k < count && ok; k++) {
+    for (int i = 0; i < rows[k] && ok; i++) {
+      ok = fwrite(mats[k][i], 1, cols[k], fp) == (size_t)cols[k];
+    }
+    uint64_t size = (uint64_t)rows[k] * cols[k];
+    ok = ok && fwrite(zeros, 1, align(size) - size, fp) == align(size) - size;
+  }
+  return (fclose(fp) == 0 && ok) ? 0 : -1;
+}
+
+struct ehtk* ehtk_open(const char* fname) {
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < HEADER_SIZE) {
+    close(fd);
+    return NULL;
+  }
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return NULL;
+  }
+
+  struct ehtk* f = malloc(sizeof(*f));
+  f->data = data;
+  f->size = st.st_size;
+  f->count = get_u32(f->data + 8);
+  int ok = memcmp(f->data, EHTK_MAGIC, 4) == 0 && get_u32(f->data + 4) == EHTK_VERSION
+    && HEADER_SIZE + (uint64_t)f->count * ENTRY_SIZE <= f->size;
+  for (uint32_t k = 0; k < f->count && ok; k++) {
+    const uint8_t* e = f->data + HEADER_SIZE + k * ENTRY_SIZE;
+    uint64_t size = (uint64_t)get_u32(e + EHTK_NAMELEN) * get_u32(e + EHTK_NAMELEN + 4);
+    ok = get_u64(e + EHTK_NAMELEN + 8) + size <= f->size;
+  }
+  if (!ok) {
+    ehtk_close(f);
+    return NULL;
+  }
+  return f;
+}
+
+void ehtk_close(struct ehtk* f) {
+  munmap((void*)f->data, f->size);
+  free(f);
+}
+
+const uint8_t* ehtk_find(const struct ehtk* f, const char* name, int* rows, int* cols) {
+  for (uint32_t k = 0; k < f->count; k++) {
+    const uint8_t* e = f->data + HEADER_SIZE + k * ENTRY_SIZE;
+    if (strncmp((const char*)e, name, EHTK_NAMELEN) == 0) {
+      *rows = get_u32(e + EHTK_NAMELEN);
+      *cols = get_u32(e + EHTK_NAMELEN + 4);
+      return f->data + get_u64(e + EHTK_NAMELEN + 8);
+    }
+  }
+  return NULL;
+}
+
+int ehtk_is_ehtk(const char* fname) {
+  char magic[4];
+  FILE* fp = fopen(fname, "rb");
+  if (fp == NULL) {
+    return 0;
+  }
+  int ret = fread(magic, 1, 4, fp) == 4 && memcmp(magic, EHTK_MAGIC, 4) == 0;
+  fclose(fp);
+  return ret;
+}
@@ -0,0 +1,39 @@
+#ifndef ehtk_h
+#define ehtk_h
+
+#include <stdint.h>
+
+// .ehtk files: a small binary container for keys (the matrices of a public key,
+// real private key or recovered partial key), read by keys.py and the C tools.
+// Much faster to write and load than the JSON written by eht_print_sk and
+// partial_key_recovery.py, and the matrices can be used straight from an mmap.
+//
+// Layout (all integers little endian):
+//   "EHTK", u32 version (1), u32 count
+//   count entries of: char name[8] (NUL padded), u32 rows, u32 cols, u64 offset
+//   the matrices, each rows x cols uint8_t residues, row-major, starting at offset
+//   (a multiple of EHTK_ALIGN)
+
+#define EHTK_MAGIC "EHTK"
+#define EHTK_VERSION 1
+#define EHTK_ALIGN 64
+#define EHTK_NAMELEN 8
+
+struct ehtk;
+
+// Writes count matrices (in the unsigned char** layout of the reference
+// implementation) to fname. Returns 0, or -1 if the file couldn't be written.
+int ehtk_write(const char* fname, int count, const char* const* names,
+               const int* rows, const int* cols, unsigned char*** mats);
+
+// Maps fname. Returns NULL if it can't be opened or is not an .ehtk file.
+struct ehtk* ehtk_open(const char* fname);
+void ehtk_close(struct ehtk* f);
+
+// The matrix called name in f (valid until ehtk_close), or NULL if there is none
+const uint8_t* ehtk_find(const struct ehtk* f, const char* name, int* rows, int* cols);
+
+// Whether fname starts like an .ehtk file
+int ehtk_is_ehtk(const char* fname);
+
+#endif
@@ -11,13 +11,15 @@ You are solely responsible for determining the appropriateness of using and dist
 #ifndef api_h
 #define api_h
 
-//  Set these three values apropriately for your algorithm
-#define CRYPTO_SECRETKEYBYTES 368
-#define CRYPTO_PUBLICKEYBYTES 83490
-#define CRYPTO_BYTES 169
+#include "parameters.h"
+
+//  Set these three values apropriately for your algorithm (they come from the parameter set, see parameters.h)
+#define CRYPTO_SECRETKEYBYTES EHT_SECRETKEYBYTES
+#define CRYPTO_PUBLICKEYBYTES EHT_PUBLICKEYBYTES
+#define CRYPTO_BYTES EHT_BYTES
 
 // Change the algorithm name
-#define CRYPTO_ALGNAME "ehtv3l1"
+#define CRYPTO_ALGNAME EHT_ALGNAME
 
 int crypto_sign_keypair(unsigned char *pk, unsigned char *sk);
 int crypto_sign(unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen, const unsigned char *sk);
@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <math.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "rng.h"
 #include "parameters.h"
@@ -111,8 +113,184 @@ void C1cp_to_sk(unsigned char* C1cp, unsigned char* sk)
 	}
 }
 
+#ifndef EHT_REFERENCE_CHARPOLY
+/**
+ * A small xorshift generator for the random projections of the Wiedemann algorithm.
+ * It is local on purpose: drawing from NIST_rng would change the keys that are generated.
+ *
+ * @param state Pointer to the generator state (nonzero).
+ * @return Returns a random element of GF(Q).
+ */
+static int wiedemann_rng(unsigned long long* state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return (int)(*state % Q);
+}
+
+/**
+ * This function computes the characteristic polynomial of matrix C1 with the Wiedemann algorithm, using only
+ * products of the sparse matrix C1 (NORM1 non-zero entries per row) with vectors.
+ * The sequence s_k = u * C1^k * b for random u and b is generated by a polynomial that divides the minimal
+ * polynomial of C1, which the Berlekamp-Massey algorithm finds from the first 2*M terms. If that polynomial
+ * has degree M, it is the characteristic polynomial. If its constant term is 0, C1 is singular.
+ * Otherwise the result is inconclusive (which is rare) and the caller has to use the dense algorithm.
+ *
+ * @param C Pointer to the matrix in which C1 is contained.
+ * @param C1cp Pointer to an array where the characteristic polynomial will be stored (in the same form as C1_characteristic_polynomial).
+ * @return Returns 1 if C1cp was computed and C1 is invertible, 0 if C1 is singular, and -1 if the result is inconclusive
+ *         (or memory allocation fails).
+ */
+static int C1_characteristic_polynomial_sparse(unsigned char** C, unsigned char* C1cp)
+{
+	// C1 in compressed sparse row form
+	int* row_start = malloc((M+1)*sizeof(int));
+	int* col = malloc(M*M*sizeof(int));
+	int* val = malloc(M*M*sizeof(int));
+	int* x = malloc(M*sizeof(int));
+	int* y = malloc(M*sizeof(int));
+	int* u = malloc(M*sizeof(int));
+	int* seq = malloc(2*M*sizeof(int));
+	int* conn = calloc(2*M+1, sizeof(int));
+	int* prev = calloc(2*M+1, sizeof(int));
+	int* temp = malloc((2*M+1)*sizeof(int));
+	int ret = -1;
+
+	if(row_start==NULL || col==NULL || val==NULL || x==NULL || y==NULL || u==NULL || seq==NULL || conn==NULL || prev==NULL || temp==NULL)
+	{
+		goto cleanup;
+	}
+
+	int nnz = 0;
+	for(int i=0; i<M; i++)
+	{
+		row_start[i] = nnz;
+		for(int j=0; j<M; j++)
+		{
+			if(C[i][j]!=0)
+			{
+				col[nnz] = j;
+				val[nnz] = C[i][j];
+				nnz++;
+			}
+		}
+	}
+	row_start[M] = nnz;
+
+	// s_k = u * C1^k * b, with x = C1^k * b
+	unsigned long long state = 0x9E3779B97F4A7C15ULL;
+	for(int i=0; i<M; i++)
+	{
+		u[i] = wiedemann_rng(&state);
+		x[i] = wiedemann_rng(&state);
+	}
+	for(int k=0; k<2*M; k++)
+	{
+		int s = 0;
+		for(int i=0; i<M; i++)
+		{
+			s += u[i]*x[i];
+		}
+		seq[k] = s%Q;
+
+		for(int i=0; i<M; i++)
+		{
+			int t = 0;
+			for(int e=row_start[i]; e<row_start[i+1]; e++)
+			{
+				t += val[e]*x[col[e]];
+			}
+			y[i] = t%Q;
+		}
+		int* swap = x; x = y; y = swap;
+	}
+
+	// Berlekamp-Massey: conn(z) = 1 + conn[1] z + ... + conn[len] z^len is the shortest connection polynomial,
+	// i.e. seq[k] + conn[1] seq[k-1] + ... + conn[len] seq[k-len] = 0
+	int len = 0, shift = 1, last_d = 1;
+	conn[0] = 1;
+	prev[0] = 1;
+	for(int k=0; k<2*M; k++)
+	{
+		int d = seq[k];
+		for(int i=1; i<=len; i++)
+		{
+			d += conn[i]*seq[k-i];
+		}
+		d %= Q;
+
+		if(d==0)
+		{
+			shift++;
+			continue;
+		}
+
+		int coef = d*inverse(last_d)%Q;
+		bool grow = (2*len <= k);
+		if(grow)
+		{
+			for(int i=0; i<=2*M; i++)
+			{
+				temp[i] = conn[i];
+			}
+		}
+		for(int i=0; i+shift<=2*M; i++)
+		{
+			conn[i+shift] = (conn[i+shift] + (Q-coef)*prev[i])%Q;
+		}
+		if(grow)
+		{
+			len = k+1-len;
+			for(int i=0; i<=2*M; i++)
+			{
+				prev[i] = temp[i];
+			}
+			last_d = d;
+			shift = 1;
+		}
+		else
+		{
+			shift++;
+		}
+	}
+
+	// The generator is z^len conn(1/z), so its constant term is conn[len]
+	if(conn[len]==0)
+	{
+		ret = 0; // C1 is not invertible
+	}
+	else if(len==M)
+	{
+		// Same sign convention as the dense algorithm: the leading coefficient is (-1)^M
+		int sign = (M%2==0) ? 1 : Q-1;
+		for(int i=0; i<=M; i++)
+		{
+			C1cp[i] = sign*conn[M-i]%Q;
+		}
+		ret = 1;
+	}
+
+	cleanup:
+		free(row_start);
+		free(col);
+		free(val);
+		free(x);
+		free(y);
+		free(u);
+		free(seq);
+		free(conn);
+		free(prev);
+		free(temp);
+		return ret;
+}
+
+#endif
+
+#if defined(EHT_REFERENCE_CHARPOLY) || defined(EHT_CHECK_CHARPOLY)
 /**
  * This function generates the characteristic polynomial of matrix C1. According to Algorithm 2.2.9 from "A Course in Computational Algebraic Number Theory" by Henri Cohen.
+ * This is the reference version, with all arithmetic through the lookup tables. C1_characteristic_polynomial_dense computes the same thing much faster.
  *
  * @param C Pointer to the matrix in which C1 is contained for which the characteristic polynomial is to be computed.
  * @param H Pointer to the Hessenberg matrix which will be filled during computation.
@@ -120,7 +298,7 @@ void C1cp_to_sk(unsigned char* C1cp, unsigned char* sk)
  * @param C1cp Pointer to an array where the characteristic polynomial will be stored.
  * @return Returns a boolean indicating if C1 is invertible by checking if the first coefficient in the characteristic polynomial is non-zero.
  */
-bool C1_characteristic_polynomial(unsigned char** C, unsigned char** H, unsigned char** CP, unsigned char* C1cp)
+static bool C1_characteristic_polynomial_reference(unsigned char** C, unsigned char** H, unsigned char** CP, unsigned char* C1cp)
 {
 	// Copy matrix C into H. H will be transformed into a Hessenberg matrix.
 	for(int i=0; i<M; i++)
@@ -267,6 +445,242 @@ bool C1_characteristic_polynomial(unsigned char** C, unsigned char** H, unsigned
 	}
 }
 
+#endif
+
+#ifndef EHT_REFERENCE_CHARPOLY
+/**
+ * Barrett reduction modulo Q. Unlike x%Q, this vectorizes. For Q = 47 it is exact for 0 <= x < 59924 (and wrong for
+ * some larger x < 2^16); C1_characteristic_polynomial_dense only passes x <= (Q-1) + Q*(Q-1) = 2208.
+ *
+ * @param x The value to reduce.
+ * @param mu The Barrett constant 2^21/Q + 1 (see C1_characteristic_polynomial_dense).
+ * @return Returns x mod Q.
+ */
+static inline uint16_t barrett_reduce(uint32_t x, uint32_t mu)
+{
+	return x - Q*((x*mu) >> 21);
+}
+
+/**
+ * This function computes the same characteristic polynomial as C1_characteristic_polynomial_reference, with the
+ * same algorithm, but laid out so that the compiler can vectorize it (and, with -fopenmp, spread it over threads):
+ * H is one contiguous array of bytes, and reductions modulo Q are Barrett reductions or delayed to the end of a sum.
+ *
+ * Step m of the Hessenberg reduction is the similarity transform H -> E H E^-1 with E = I - sum_i u_i e_i e_m^T
+ * (for rows i > m). The reference interleaves the row operations of E and the column operations of E^-1 for each i;
+ * here all row operations (row i -= u_i * row m) come first, and then the column operations
+ * (column m += sum_i u_i * column i) are done as one dot product per row, which walks along the rows instead of
+ * down the columns. The result is the same.
+ *
+ * @param C Pointer to the matrix in which C1 is contained.
+ * @param C1cp Pointer to an array where the characteristic polynomial will be stored.
+ * @return Returns 1 if C1cp was computed and C1 is invertible, 0 if C1 is singular, and -1 if memory allocation fails.
+ */
+static int C1_characteristic_polynomial_dense(unsigned char** C, unsigned char* C1cp)
+{
+	// (x*mu) >> 21 is x/Q rounded down for the values reduced below: a residue plus Q times a residue is at most 2208
+	const uint32_t mu = (1u << 21)/Q + 1;
+	uint8_t* H = malloc((size_t)M*M);
+	uint8_t* u = calloc(M, 1);
+	uint8_t* CP = calloc((size_t)(M+1)*(M+1), 1);
+	uint32_t* acc = malloc((M+1)*sizeof(uint32_t));
+	int ret = -1;
+
+	if(H==NULL || u==NULL || CP==NULL || acc==NULL)
+	{
+		goto cleanup;
+	}
+
+	for(int i=0; i<M; i++)
+	{
+		for(int j=0; j<M; j++)
+		{
+			H[i*M+j] = C[i][j];
+		}
+	}
+
+	// Convert matrix H into a Hessenberg matrix
+	for(int m=1; m<M-1; m++)
+	{
+		int i;
+		for(i=m+1; i<M; i++)
+		{
+			if(H[i*M+m-1]!=0)
+			{
+				break;
+			}
+		}
+		if(i==M)
+		{
+			continue;
+		}
+		if(H[m*M+m-1]!=0)
+		{
+			i = m;
+		}
+
+		// Swap the i-th row and the m-th row, and the i-th column and the m-th column
+		if(i!=m)
+		{
+			for(int j=0; j<M; j++)
+			{
+				uint8_t temp = H[i*M+j];
+				H[i*M+j] = H[m*M+j];
+				H[m*M+j] = temp;
+			}
+			for(int j=0; j<M; j++)
+			{
+				uint8_t temp = H[j*M+i];
+				H[j*M+i] = H[j*M+m];
+				H[j*M+m] = temp;
+			}
+		}
+
+		int t_inv = inverse(H[m*M+m-1]);
+		for(i=m+1; i<M; i++)
+		{
+			u[i] = H[i*M+m-1]*t_inv%Q;
+		}
+
+		// Row i -= u_i * row m
+		const uint8_t* pivot = H + m*M;
+		#pragma omp parallel for schedule(static)
+		for(int i=m+1; i<M; i++)
+		{
+			if(u[i]!=0)
+			{
+				uint8_t* row = H + (size_t)i*M;
+				uint32_t f = Q - u[i];
+				for(int j=m-1; j<M; j++)
+				{
+					row[j] = barrett_reduce(row[j] + f*pivot[j], mu);
+				}
+			}
+		}
+
+		// Column m += sum_i u_i * column i
+		#pragma omp parallel for schedule(static)
+		for(int j=0; j<M; j++)
+		{
+			const uint8_t* row = H + (size_t)j*M;
+			uint32_t sum = row[m];
+			for(int i=m+1; i<M; i++)
+			{
+				sum += u[i]*row[i];
+			}
+			H[(size_t)j*M+m] = sum%Q;
+		}
+	}
+
+	// Determine characteristic polynomial coefficients; CP[m] is row m of CP
+	CP[0] = (M%2==0) ? 1 : Q-1;
+	for(int m=0; m<M; m++)
+	{
+		const uint8_t* prev = CP + (size_t)m*(M+1);
+		uint8_t* next = CP + (size_t)(m+1)*(M+1);
+		uint32_t c = Q - H[m*M+m];
+
+		// Multiply the current polynomial by x - c
+		next[0] = barrett_reduce(c*prev[0], mu);
+		for(int i=1; i<=m+1; i++)
+		{
+			next[i] = barrett_reduce(prev[i-1] + c*prev[i], mu);
+		}
+
+		// Subtract the products of the Hessenberg coefficients and the previous polynomials, summed without reduction
+		for(int j=0; j<=m+1; j++)
+		{
+			acc[j] = 0;
+		}
+		int t = 1;
+		for(int i=0; i<m; i++)
+		{
+			t = t*H[(m-i)*M+m-i-1]%Q;
+			uint32_t w = t*H[(m-i-1)*M+m]%Q;
+			const uint8_t* older = CP + (size_t)(m-i-1)*(M+1);
+			if(w!=0)
+			{
+				for(int j=0; j<=m-i-1; j++)
+				{
+					acc[j] += w*older[j];
+				}
+			}
+		}
+		for(int j=0; j<=m+1; j++)
+		{
+			next[j] = (next[j] + Q - acc[j]%Q)%Q;
+		}
+	}
+
+	const uint8_t* cp = CP + (size_t)M*(M+1);
+	ret = 0;
+	if(cp[0]!=0)
+	{
+		for(int i=0; i<M+1; i++)
+		{
+			C1cp[i] = cp[i];
+		}
+		ret = 1;
+	}
+
+	cleanup:
+		free(H);
+		free(u);
+		free(CP);
+		free(acc);
+		return ret;
+}
+
+#endif
+
+/**
+ * This function generates the characteristic polynomial of matrix C1 (see C1_characteristic_polynomial_reference).
+ * It uses the sparse algorithm, and the fast dense one only if the sparse one is inconclusive. Compiled with
+ * -DEHT_REFERENCE_CHARPOLY, it uses the reference algorithm only. Compiled with -DEHT_CHECK_CHARPOLY, it runs all
+ * three, returns the result of the reference algorithm and aborts if the sparse (when conclusive) or the dense one
+ * disagrees with it.
+ *
+ * @param C Pointer to the matrix in which C1 is contained for which the characteristic polynomial is to be computed.
+ * @param H Pointer to the Hessenberg matrix which will be filled during computation (by the reference algorithm).
+ * @param CP Pointer to the matrix where the characteristic polynomial coefficients will be stored (by the reference algorithm).
+ * @param C1cp Pointer to an array where the characteristic polynomial will be stored.
+ * @return Returns 1 if C1 is invertible (the first coefficient in the characteristic polynomial is non-zero), 0 if it is
+ *         singular, and -1 if memory allocation fails.
+ */
+int C1_characteristic_polynomial(unsigned char** C, unsigned char** H, unsigned char** CP, unsigned char* C1cp)
+{
+#if defined(EHT_REFERENCE_CHARPOLY)
+	return C1_characteristic_polynomial_reference(C, H, CP, C1cp);
+#elif defined(EHT_CHECK_CHARPOLY)
+	bool reference = C1_characteristic_polynomial_reference(C, H, CP, C1cp);
+	unsigned char fast[M+1];
+	int sparse = C1_characteristic_polynomial_sparse(C, fast);
+	if(sparse>=0 && (sparse!=reference || (reference && memcmp(fast, C1cp, M+1)!=0)))
+	{
+		fprintf(stderr, "C1_characteristic_polynomial: the sparse algorithm disagrees with the reference\n");
+		abort();
+	}
+	int dense = C1_characteristic_polynomial_dense(C, fast);
+	if(dense<0)
+	{
+		return -1;
+	}
+	if(dense!=reference || (reference && memcmp(fast, C1cp, M+1)!=0))
+	{
+		fprintf(stderr, "C1_characteristic_polynomial: the dense algorithm disagrees with the reference\n");
+		abort();
+	}
+	return reference;
+#else
+	int sparse = C1_characteristic_polynomial_sparse(C, C1cp);
+	if(sparse>=0)
+	{
+		return sparse;
+	}
+	return C1_characteristic_polynomial_dense(C, C1cp);
+#endif
+}
+
 /**
  * This function generates matrix C and a secret key sk.
  * The function first finds a suitable (invertible) matrix C1 (which is a part of matrix C), and then fills the rest of matrix C.
@@ -275,8 +689,9 @@ bool C1_characteristic_polynomial(unsigned char** C, unsigned char** H, unsigned
  * @param H A pointer to a matrix that becomes the Hessenberg Matrix form of C1
  * @param CP A pointer to the matrix for storing the characteristic polynomial.
  * @param sk A pointer to the secret key.
+ * @return 0 if the function was successful, -2 if memory allocation fails.
  */
-void generate_C_sk(unsigned char** C, unsigned char** H, unsigned char** CP, unsigned char* sk)
+int generate_C_sk(unsigned char** C, unsigned char** H, unsigned char** CP, unsigned char* sk)
 {
     // C1_index is a helper matrix that stores indices for the non-zero elements of C1.
     // C1cp is an array that will hold the characteristic polynomial of C1.
@@ -287,7 +702,7 @@ void generate_C_sk(unsigned char** C, unsigned char** H, unsigned char** CP, uns
 
     // The outer loop runs until a suitable C1 is found.
     // A suitable C1 should have a non-zero constant term in its first characteristic polynomial coefficient (indicating it is invertible).
-    bool check1 = 0;
+    int check1 = 0;
     while(check1==0)
     {
         // Initialize the random number generator
@@ -371,6 +786,10 @@ void generate_C_sk(unsigned char** C, unsigned char** H, unsigned char** CP, uns
         // Check if C1 is invertible through its characteristic polynomial
         check1 = C1_characteristic_polynomial(C, H, CP, C1cp);
     }
+    if(check1<0)
+    {
+        return -2;
+    }
 
     // Store the characteristic polynomial of C1 in the secret key
     C1cp_to_sk(C1cp, sk);
@@ -399,59 +818,107 @@ void generate_C_sk(unsigned char** C, unsigned char** H, unsigned char** CP, uns
 			}
 		}
 	}
+
+	return 0;
 }
 
 /**
- * This function calculates the inverse of a triangular matrix.
- * The type parameter defines whether the matrix is lower triangular (type=0) or upper triangular (type=1).
+ * This function computes the public matrix A = C*T*Binv, with Binv = U^-1*L^-1 for the triangular factors U and L of B.
+ * It uses the structure of the factors instead of dense products: row r of C*T is the sum of at most NORM1+NORM2 rows
+ * of T (times the nonzero entries of row r of C), row k of T being zero past column k/2, and row r of A is then found
+ * by substitution from y*U = (C*T)[r] and A[r]*L = y. Sums are accumulated in 16 bits and only reduced modulo Q when
+ * a value is needed or before they could overflow, so the inner loops vectorize.
  *
- * @param n The number of rows (and columns) in the matrix.
- * @param A A pointer to the input triangular matrix.
- * @param Ainv A pointer to the matrix where the result (inverse of matrix A) will be stored.
- * @param type The type of triangular matrix (0 for lower triangular, 1 for upper triangular).
+ * @param C Pointer to the matrix C.
+ * @param T Pointer to the matrix T.
+ * @param L Pointer to the lower triangular factor of B.
+ * @param U Pointer to the upper triangular factor of B.
+ * @param A Pointer to the matrix where A will be stored.
  */
-void triangular_matrix_inverse(int n, unsigned char** A, unsigned char** Ainv, int type)
+static void compute_A(unsigned char** C, unsigned char** T, unsigned char** L, unsigned char** U, unsigned char** A)
 {
-	int l, u;  // Auxiliary variables to work with the type of triangular matrix
+	// acc holds reduced values plus at most lazy products of two residues before it has to be reduced again
+	const int lazy = (UINT16_MAX - (Q-1))/((Q-1)*(Q-1));
+	uint16_t acc[N];
+	int inv_L[N], inv_U[N];
 
-	// Determine the type of triangular matrix
-	if(type==0)
+	for(int j=0; j<N; j++)
 	{
-		l = 1;  // For a lower triangular matrix, the lower part is processed
-		u = 0;  // and the upper part is ignored
+		inv_L[j] = inverse(L[j][j]);
+		inv_U[j] = inverse(U[j][j]);
 	}
-	if(type==1)
+
+	for(int r=0; r<M; r++)
 	{
-		l = 0;  // For an upper triangular matrix, the upper part is processed
-		u = 1;  // and the lower part is ignored
-	}
+		int terms = 0;
 
-	// Initialize the resulting matrix (Ainv) as a zero matrix
-	zero_matrix(n, n, Ainv);
+		// acc = (C*T)[r]
+		for(int j=0; j<N; j++)
+		{
+			acc[j] = 0;
+		}
+		for(int k=0; k<K*N; k++)
+		{
+			uint16_t c = C[r][k];
+			if(c!=0)
+			{
+				if(++terms>lazy)
+				{
+					for(int j=0; j<N; j++)
+					{
+						acc[j] %= Q;
+					}
+					terms = 1;
+				}
+				const unsigned char* t = T[k];
+				for(int j=0; j<=k/2; j++)
+				{
+					acc[j] += c*t[j];
+				}
+			}
+		}
 
-	// The diagonal of the inverse of a triangular matrix is the inverse of the original diagonal
-	for(int i=0; i<n; i++)
-	{
-		Ainv[i][i] = inverse(A[i][i]);  // Inverse each diagonal element
-	}
+		// Solve y*U = acc: y_j = (acc_j - sum_{k<j} y_k*U_kj) / U_jj, subtracting y_j*U_jk from acc_k as soon as y_j is known
+		for(int j=0; j<N; j++)
+		{
+			uint16_t y = (acc[j]%Q)*inv_U[j]%Q;
+			uint16_t f = Q - y;
+			const unsigned char* u = U[j];
+			acc[j] = y;
+			if(++terms>lazy)
+			{
+				for(int k=j+1; k<N; k++)
+				{
+					acc[k] %= Q;
+				}
+				terms = 1;
+			}
+			for(int k=j+1; k<N; k++)
+			{
+				acc[k] += f*u[k];
+			}
+		}
 
-	// Compute the off-diagonal elements of the inverse matrix
-	for(int j=1; j<n; j++)
-	{
-		for(int i=0; i<n-j; i++)
-	    {
-	    	int psum = 0;  // Initialize partial sum
-	    	int inv = inverse(A[i][i]);  // Inverse the diagonal element
-	    	
-	    	// Compute the partial sum
-	    	for(int k=1; k<=j; k++)
-	    	{
-	    		// Add the product of corresponding elements from the original and inverse matrices
-	    		psum = psum + A[i+k*l][i+k*u]*Ainv[i+j*l+k*u][i+j*u+k*l];
+		// Solve A[r]*L = y, from the last entry to the first
+		terms = 0;
+		for(int j=N-1; j>=0; j--)
+		{
+			uint16_t a = (acc[j]%Q)*inv_L[j]%Q;
+			uint16_t f = Q - a;
+			const unsigned char* l = L[j];
+			A[r][j] = a;
+			if(++terms>lazy)
+			{
+				for(int k=0; k<j; k++)
+				{
+					acc[k] %= Q;
+				}
+				terms = 1;
+			}
+			for(int k=0; k<j; k++)
+			{
+				acc[k] += f*l[k];
 			}
-			
-	    	// Compute and assign the off-diagonal element of the inverse matrix
-	    	Ainv[i+j*l][i+j*u] = mod_q(-1*inv*psum);
 		}
 	}
 }
@@ -470,16 +937,13 @@ int key_gen(unsigned char *pk, unsigned char *sk)
 	// *** peak memory estimate of key_gen (v3l1): 769 kilobytes ***
 	
     // Declare the variables that will be allocated memory in the function
-	unsigned char** C;
-	unsigned char** H;
-	unsigned char** CP;
-	unsigned char** T;
-	unsigned char** TM;
-	unsigned char** Linv;
-	unsigned char** Uinv;
-	unsigned char** Binv;
-	unsigned char** TBinv;
-	unsigned char** A;
+	unsigned char** C = NULL;
+	unsigned char** H = NULL;
+	unsigned char** CP = NULL;
+	unsigned char** T = NULL;
+	unsigned char** L = NULL;
+	unsigned char** U = NULL;
+	unsigned char** A = NULL;
 	
 	C = allocate_unsigned_char_matrix_memory(M, M+D);
 	H = allocate_unsigned_char_matrix_memory(M, M);
@@ -491,7 +955,10 @@ int key_gen(unsigned char *pk, unsigned char *sk)
 	}
 	
     // Generate the matrix C and the private key sk.
-	generate_C_sk(C, H, CP, sk);
+	if(generate_C_sk(C, H, CP, sk)!=0)
+	{
+		goto cleanup;
+	}
 	
     // We no longer need the matrices H and CP.
 	free_matrix(M, H); H = NULL;
@@ -520,80 +987,41 @@ int key_gen(unsigned char *pk, unsigned char *sk)
 		T[i][i/2] = TUPPLE[i%K];
 	}
 	
-    // Generate the inverse of the matrix B.
-	TM = allocate_unsigned_char_matrix_memory(N, N);
-	Linv = allocate_unsigned_char_matrix_memory(N, N);
-	Uinv = allocate_unsigned_char_matrix_memory(N, N);
+    // Generate the triangular factors of the matrix B = L*U.
+	L = allocate_unsigned_char_matrix_memory(N, N);
+	U = allocate_unsigned_char_matrix_memory(N, N);
 	
-	if(TM==NULL || Linv==NULL || Uinv==NULL)
+	if(L==NULL || U==NULL)
 	{
 		goto cleanup;
 	}
 	
-    // Initialize TM to a random lower triangular matrix.
-	zero_matrix(N, N, TM);
+    // Initialize L to a random lower triangular matrix.
+	zero_matrix(N, N, L);
 	
 	for(int i=0; i<N; i++)
 	{
-		TM[i][i] = 1 + NIST_rng(Q-1);
+		L[i][i] = 1 + NIST_rng(Q-1);
 
 		for(int j=i+1; j<N; j++)
 		{
-			TM[j][i] = NIST_rng(Q);
+			L[j][i] = NIST_rng(Q);
 		}
     }
     
-    // Compute the inverse of TM, storing the result in Linv.
-	triangular_matrix_inverse(N, TM, Linv, 0);
-	
-    // Initialize TM to a random upper triangular matrix.
-	zero_matrix(N, N, TM);
+    // Initialize U to a random upper triangular matrix.
+	zero_matrix(N, N, U);
 	
 	for(int i=0; i<N; i++)
 	{
-		TM[i][i] = 1 + NIST_rng(Q-1);
+		U[i][i] = 1 + NIST_rng(Q-1);
 		
 		for(int j=0; j<i; j++)
 		{
-			TM[j][i] = NIST_rng(Q);
+			U[j][i] = NIST_rng(Q);
 		}
     }
 	
-    // Compute the inverse of TM, storing the result in Uinv.
-	triangular_matrix_inverse(N, TM, Uinv, 1);
-	
-    // We no longer need the matrix TM.
-    free_matrix(N, TM); TM = NULL;
-	
-	Binv = allocate_unsigned_char_matrix_memory(N, N);
-	
-	if(Binv==NULL)
-	{
-		goto cleanup;
-	}
-	
-    // Compute Binv = Uinv*Linv.
-	matrix_multiply(N, N, N, Uinv, Linv, Binv);
-	
-    // We no longer need the matrices Linv and Uinv.
-	free_matrix(N, Linv); Linv = NULL;
-	free_matrix(N, Uinv); Uinv = NULL;
-	
-    // Generate the matrix A.
-	TBinv = allocate_unsigned_char_matrix_memory(K*N, N);
-	
-	if(TBinv==NULL)
-	{
-		goto cleanup;
-	}
-	
-    // Compute TBinv = T*Binv.
-	matrix_multiply(K*N, N, N, T, Binv, TBinv);
-	
-    // We no longer need the matrices T and Binv.
-	free_matrix(K*N, T); T = NULL;
-	free_matrix(N, Binv); Binv = NULL;
-	
 	A = allocate_unsigned_char_matrix_memory(M, N);
 	
 	if(A==NULL)
@@ -601,12 +1029,14 @@ int key_gen(unsigned char *pk, unsigned char *sk)
 		goto cleanup;
 	}
 	
-    // Compute A = C*TBinv.
-    matrix_multiply(M, K*N, N, C, TBinv, A);
+    // Compute A = C*T*Binv, with Binv = U^-1*L^-1.
+    compute_A(C, T, L, U, A);
     
-    // We no longer need the matrices C and TBinv.
+    // We no longer need the matrices C, T, L and U.
     free_matrix(M, C); C = NULL;
-    free_matrix(K*N, TBinv); TBinv = NULL;
+    free_matrix(K*N, T); T = NULL;
+    free_matrix(N, L); L = NULL;
+    free_matrix(N, U); U = NULL;
     
     // Store A into the public key.
     A_to_pk(A, pk);
@@ -624,11 +1054,8 @@ int key_gen(unsigned char *pk, unsigned char *sk)
 		free_matrix(M, H); H = NULL;
 		free_matrix(M+1, CP); CP = NULL;
 		free_matrix(K*N, T); T = NULL;
-		free_matrix(N, TM); TM = NULL;
-		free_matrix(N, Linv); Linv = NULL;
-		free_matrix(N, Uinv); Uinv = NULL;
-		free_matrix(N, Binv); Binv = NULL;
-		free_matrix(K*N, TBinv); TBinv = NULL;
+		free_matrix(N, L); L = NULL;
+		free_matrix(N, U); U = NULL;
 		free_matrix(M, A); A = NULL;
 		
 		// The function failed to allocate memory at some point
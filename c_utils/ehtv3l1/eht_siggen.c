@@ -7,6 +7,8 @@
 #include "parameters.h"
 #include "general_functions.h"
 #include "general_functions_with_tables.h"
+#include "eht_siggen.h"
+#include "instrument.h"
 
 /**
  * This function converts part of the secret key to the base of Q and stores it in C1cp which is the characteristic polynomial of matrix C1.
@@ -314,60 +316,71 @@ void solve_z(unsigned char** T, unsigned char** a, unsigned char** y, unsigned c
 	}
 }
 
+// Defined in rng.c
+extern __thread AES256_CTR_DRBG_struct DRBG_ctx;
+
 /**
- * This function generates the EHTv3 cryptographic signature for a given message.
- * The signature is encoded in the 'sm' array, and the length of the signature is stored in 'smlen'.
+ * This function frees the memory of an expanded secret key. It can be called on a partially expanded key.
+ *
+ * @param esk A pointer to the expanded secret key.
+ */
+void free_expanded_sk(expanded_sk *esk)
+{
+	if(esk->C!=NULL) free_matrix(M, esk->C);
+	if(esk->C1_index!=NULL) free_short_matrix(M, esk->C1_index);
+	if(esk->C1_value!=NULL) free_matrix(M, esk->C1_value);
+	if(esk->T!=NULL) free_matrix(K*N, esk->T);
+	if(esk->B!=NULL) free_matrix(N, esk->B);
+	free(esk->C1cp);
+	
+	esk->C = NULL;
+	esk->C1_index = NULL;
+	esk->C1_value = NULL;
+	esk->T = NULL;
+	esk->B = NULL;
+	esk->C1cp = NULL;
+}
+
+/**
+ * This function does the part of sig_gen that depends only on the secret key: it generates the matrices C, T and B
+ * from the seed in sk, reads the characteristic polynomial of C1, and saves the state of the rng afterwards, so that
+ * sig_gen_expanded can sign any number of messages with it.
  *
- * @param sm A pointer to the array where the signature will be stored.
- * @param smlen A pointer to the variable where the length of the signature will be stored.
- * @param m A pointer to the message.
- * @param mlen The length of the message.
  * @param sk A pointer to the secret key.
+ * @param esk A pointer to the expanded secret key to fill in.
  * @return 0 for successful execution and -2 if memory allocation fails.
  */
-int sig_gen(unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen, const unsigned char *sk)
+int expand_sk(const unsigned char *sk, expanded_sk *esk)
 {
-	// *** peak memory estimate of sig_gen (v3l1): 529 kilobytes ***
+	unsigned char** LM = NULL;
+	unsigned char** UM = NULL;
+	INSTRUMENT_START(t);
 	
 	// Initialize the rng
 	randombytes_init((unsigned char*)sk, NULL, 256);
 	
-	// Declare the variables that will be allocated memory in the function
-	unsigned char** C;
-	unsigned short** C1_index;
-	unsigned char** C1_value;
-	unsigned char** T;
-	unsigned char** B;
-	unsigned char** LM;
-	unsigned char** UM;
-	unsigned char** h;
-	unsigned char* C1cp;
-	unsigned char** y;
-	unsigned char** a;
-	unsigned char** z;
-	unsigned char** x;
-	
-	// Generate the matrix C
-	C = allocate_unsigned_char_matrix_memory(M, M+D);
-	C1_index = allocate_unsigned_short_matrix_memory(M, NORM1);
-	C1_value = allocate_unsigned_char_matrix_memory(M, NORM1);
+	esk->C = allocate_unsigned_char_matrix_memory(M, M+D);
+	esk->C1_index = allocate_unsigned_short_matrix_memory(M, NORM1);
+	esk->C1_value = allocate_unsigned_char_matrix_memory(M, NORM1);
+	esk->T = allocate_unsigned_char_matrix_memory(K*N, N);
+	esk->B = allocate_unsigned_char_matrix_memory(N, N);
+	esk->C1cp = allocate_unsigned_char_vector_memory(M+1);
+	LM = allocate_unsigned_char_matrix_memory(N, N);
+	UM = allocate_unsigned_char_matrix_memory(N, N);
 	
-	if(C==NULL || C1_index==NULL || C1_value==NULL)
+	if(esk->C==NULL || esk->C1_index==NULL || esk->C1_value==NULL || esk->T==NULL || esk->B==NULL || esk->C1cp==NULL || LM==NULL || UM==NULL)
 	{
-		goto cleanup;
+		free_expanded_sk(esk);
+		if(LM!=NULL) free_matrix(N, LM);
+		if(UM!=NULL) free_matrix(N, UM);
+		return -2;
 	}
 	
-	generate_C(C, C1_index, C1_value);
+	// Generate the matrix C
+	generate_C(esk->C, esk->C1_index, esk->C1_value);
 	
 	// Generate the matrix T.
-	T = allocate_unsigned_char_matrix_memory(K*N, N);
-	
-	if(T==NULL)
-	{
-		goto cleanup;
-	}
-	
-	// Initialize T to all zeros.
+	unsigned char** T = esk->T;
 	zero_matrix(K*N, N, T);
 	
 	for(int i=0; i<K*N; i++)
@@ -383,15 +396,6 @@ int sig_gen(unsigned char *sm, unsigned long long *smlen, const unsigned char *m
 	}
 	
 	// Matrix B Generation from LM and UM (lower and upper triangular matrix construction)
-	B = allocate_unsigned_char_matrix_memory(N, N);
-	LM = allocate_unsigned_char_matrix_memory(N, N);
-	UM = allocate_unsigned_char_matrix_memory(N, N);
-	
-	if(B==NULL || LM==NULL || UM==NULL)
-	{
-		goto cleanup;
-	}
-	
 	zero_matrix(N, N, LM);
 	
 	for(int i=0; i<N; i++)
@@ -417,51 +421,75 @@ int sig_gen(unsigned char *sm, unsigned long long *smlen, const unsigned char *m
     }
     
     // Compute B = LM*UM
-    matrix_multiply(N, N, N, LM, UM, B); 
+    matrix_multiply(N, N, N, LM, UM, esk->B); 
 	
-	// We no longer need the matrices LM and UM.
-	free_matrix(N, LM); LM = NULL;
-	free_matrix(N, UM); UM = NULL;
+	free_matrix(N, LM);
+	free_matrix(N, UM);
 	
-	// HASH of Message
-	h = allocate_unsigned_char_matrix_memory(M, 1);
+	// Get the characteristic polynomial of C1
+	sk_to_C1cp(sk, esk->C1cp);
 	
-	if(h == NULL)
-	{
-		goto cleanup;
-	}
+	// The rest of sig_gen continues from this state of the rng
+	esk->drbg = DRBG_ctx;
 	
-	hash_of_message(m, mlen, h);
-	
-	// Get the characteristic polynomial of C1
-	C1cp = allocate_unsigned_char_vector_memory(M+1);
+	INSTRUMENT_LAP(PHASE_EXPAND, t);
+	return 0;
+}
+
+/**
+ * This function generates the EHTv3 cryptographic signature for a given message with an expanded secret key.
+ * The result is the same as that of sig_gen with the secret key that was expanded.
+ *
+ * @param sm A pointer to the array where the signature will be stored.
+ * @param smlen A pointer to the variable where the length of the signature will be stored.
+ * @param m A pointer to the message.
+ * @param mlen The length of the message.
+ * @param esk A pointer to the expanded secret key (see expand_sk).
+ * @return 0 for successful execution and -2 if memory allocation fails.
+ */
+int sig_gen_expanded(unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen, const expanded_sk *esk)
+{
+	unsigned char** C = esk->C;
 	
-	if(C1cp == NULL)
-	{
-		goto cleanup;
-	}
+	// Declare the variables that will be allocated memory in the function
+	unsigned char** h;
+	unsigned char** y;
+	unsigned char** a;
+	unsigned char** z;
+	unsigned char** x;
 	
-	sk_to_C1cp(sk, C1cp);
+	// Continue from the state of the rng after the key expansion
+	DRBG_ctx = esk->drbg;
 	
-	// Find a valid signature
+	h = allocate_unsigned_char_matrix_memory(M, 1);
 	y = allocate_unsigned_char_matrix_memory(N, 1);
 	a = allocate_unsigned_char_matrix_memory(M+D, 1);
 	z = allocate_unsigned_char_matrix_memory(K*N, 1);
+	x = allocate_unsigned_char_matrix_memory(N, 1);
 	
-	if(y == NULL || a == NULL || z == NULL)
+	if(h==NULL || y==NULL || a==NULL || z==NULL || x==NULL)
 	{
 		goto cleanup;
 	}
 	
+	// HASH of Message
+	INSTRUMENT_START(t);
+	hash_of_message(m, mlen, h);
+	INSTRUMENT_LAP(PHASE_HASH, t);
+	
 	// Here we randomize tail entries of 'a' and solve for the remaing of 'a' and then for 'z' 
 	// from these we can check if sufficient (L) values from e = C*z are within the bound S
 	int within_bound = 0;
+	int attempts = 0;
 	while(within_bound<L)
 	{
 		within_bound = 0;
+		attempts++;
 		
-		solve_a(C, C1_index, C1_value, C1cp, h, a);
-		solve_z(T, a, y, z);
+		solve_a(C, esk->C1_index, esk->C1_value, esk->C1cp, h, a);
+		INSTRUMENT_LAP(PHASE_SOLVE_A, t);
+		solve_z(esk->T, a, y, z);
+		INSTRUMENT_LAP(PHASE_SOLVE_Z, t);
 		
 		for(int i=0; i<M; i++)
 		{
@@ -479,60 +507,69 @@ int sig_gen(unsigned char *sm, unsigned long long *smlen, const unsigned char *m
 				within_bound++;
 			}
 		}
+		INSTRUMENT_LAP(PHASE_BOUND, t);
+		INSTRUMENT_ATTEMPT(within_bound);
 	}
-	
-	// We no longer need the following
-	free_matrix(M, C); C = NULL;
-	free_short_matrix(M, C1_index); C1_index = NULL;
-	free_matrix(M, C1_value); C1_value = NULL;
-	free_matrix(K*N, T); T = NULL;
-	free_matrix(M, h); h = NULL;
-	free(C1cp); C1cp = NULL;
-	free_matrix(M+D, a); a = NULL;
-	free_matrix(K*N, z); z = NULL;
-	
-	// Compute x (signature)
-	x = allocate_unsigned_char_matrix_memory(N, 1);
-	
-	if(x == NULL)
-	{
-		goto cleanup;
-	}
+	INSTRUMENT_SIGNATURE(attempts);
+	(void)attempts;
 	
 	// x = B*y
-	matrix_multiply(N, N, 1, B, y, x);
-	
-	free_matrix(N, B); B = NULL;
-	free_matrix(N, y); y = NULL;
+	matrix_multiply(N, N, 1, esk->B, y, x);
 	
 	// Store m and x in sm and update smlen
 	mx_to_sm(m, mlen, x, sm, smlen);
+	INSTRUMENT_LAP(PHASE_BY, t);
 	
-	free_matrix(N, x); x = NULL;
+	free_matrix(M, h);
+	free_matrix(N, y);
+	free_matrix(M+D, a);
+	free_matrix(K*N, z);
+	free_matrix(N, x);
 	
 	return 0;
 	
 	////////////////////////////////////
 	cleanup:
 		// Free all the memory we may have allocated.
-		free_matrix(M, C); C = NULL;
-		free_short_matrix(M, C1_index); C1_index = NULL;
-		free_matrix(M, C1_value); C1_value = NULL;
-		free_matrix(K*N, T); T = NULL;
-		free_matrix(N, B); B = NULL;
-		free_matrix(N, LM); LM = NULL;
-		free_matrix(N, UM); UM = NULL;
-		free_matrix(M, h); h = NULL;
-		free(C1cp); C1cp = NULL;
-		free_matrix(N, y); y = NULL;
-		free_matrix(M+D, a); a = NULL;
-		free_matrix(K*N, z); z = NULL;
-		free_matrix(N, x); x = NULL;
+		if(h!=NULL) free_matrix(M, h);
+		if(y!=NULL) free_matrix(N, y);
+		if(a!=NULL) free_matrix(M+D, a);
+		if(z!=NULL) free_matrix(K*N, z);
+		if(x!=NULL) free_matrix(N, x);
 		
 		// The function failed to allocate memory at some point
 		return -2;
 	////////////////////////////////////
 }
 
+/**
+ * This function generates the EHTv3 cryptographic signature for a given message.
+ * The signature is encoded in the 'sm' array, and the length of the signature is stored in 'smlen'.
+ * It expands the secret key (expand_sk) and signs with the expanded key (sig_gen_expanded).
+ *
+ * @param sm A pointer to the array where the signature will be stored.
+ * @param smlen A pointer to the variable where the length of the signature will be stored.
+ * @param m A pointer to the message.
+ * @param mlen The length of the message.
+ * @param sk A pointer to the secret key.
+ * @return 0 for successful execution and -2 if memory allocation fails.
+ */
+int sig_gen(unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen, const unsigned char *sk)
+{
+	// *** peak memory estimate of sig_gen (v3l1): 529 kilobytes ***
+	
+	expanded_sk esk;
+	
+	if(expand_sk(sk, &esk)!=0)
+	{
+		return -2;
+	}
+	
+	int ret = sig_gen_expanded(sm, smlen, m, mlen, &esk);
+	
+	free_expanded_sk(&esk);
+	
+	return ret;
+}
 
 
@@ -1,6 +1,26 @@
 #ifndef eht_siggen_h
 #define eht_siggen_h
 
+#include "rng.h"
+
+/**
+ * Everything sig_gen derives from the secret key before it looks at the message: the matrices C, T and B,
+ * the characteristic polynomial of C1, and the state of the rng after generating them (see expand_sk).
+ */
+typedef struct
+{
+	unsigned char** C;
+	unsigned short** C1_index;
+	unsigned char** C1_value;
+	unsigned char** T;
+	unsigned char** B;
+	unsigned char* C1cp;
+	AES256_CTR_DRBG_struct drbg;
+} expanded_sk;
+
+int expand_sk(const unsigned char *sk, expanded_sk *esk);
+void free_expanded_sk(expanded_sk *esk);
+int sig_gen_expanded(unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen, const expanded_sk *esk);
 int sig_gen(unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen, const unsigned char *sk);
 
 #endif
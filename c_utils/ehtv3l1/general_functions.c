@@ -125,6 +125,10 @@ unsigned short** allocate_unsigned_short_matrix_memory(int m, int n)
  */
 void free_matrix(int m, unsigned char** A)
 {
+    if(A==NULL)
+    {
+        return; // Nothing was allocated, like free(NULL)
+    }
     for(int i=0; i<m; i++)
     {
         free(A[i]); // Free each row of the matrix
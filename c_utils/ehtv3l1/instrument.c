@@ -0,0 +1,201 @@
+#ifdef EHT_INSTRUMENT
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "parameters.h"
+#include "instrument.h"
+
+// Signatures that needed more attempts than this are counted in the last bucket
+#define MAX_ATTEMPTS 64
+
+static const char* PHASE_NAMES[NUM_PHASES] = { "expand_sk", "hash", "solve_a", "solve_z", "bound_check", "B*y" };
+
+/**
+ * The counters of one thread. They are allocated on the first use in a thread and never freed, so that they can still
+ * be read after the thread has exited.
+ */
+typedef struct eht_stats
+{
+	uint64_t cycles[NUM_PHASES];
+	uint64_t calls[NUM_PHASES];
+	uint64_t signatures;
+	uint64_t attempts;
+	uint64_t attempt_histogram[MAX_ATTEMPTS+1];
+	uint64_t* within_bound_histogram;  // M+1 buckets
+	struct eht_stats* next;
+} eht_stats;
+
+static __thread eht_stats* thread_stats;
+static eht_stats* all_stats;
+static pthread_mutex_t all_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * This function returns the counters of the calling thread, allocating and registering them on the first call.
+ *
+ * @return A pointer to the counters, or NULL if they could not be allocated.
+ */
+static eht_stats* stats(void)
+{
+	if(thread_stats==NULL)
+	{
+		eht_stats* s = calloc(1, sizeof(eht_stats));
+		if(s==NULL || (s->within_bound_histogram = calloc(M+1, sizeof(uint64_t)))==NULL)
+		{
+			free(s);
+			return NULL;
+		}
+		pthread_mutex_lock(&all_stats_lock);
+		s->next = all_stats;
+		all_stats = s;
+		pthread_mutex_unlock(&all_stats_lock);
+		thread_stats = s;
+	}
+	return thread_stats;
+}
+
+/**
+ * This function returns a timestamp in cycles (rdtsc on x86, nanoseconds elsewhere).
+ */
+uint64_t eht_instrument_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec*1000000000 + t.tv_nsec;
+#endif
+}
+
+/**
+ * This function adds the time since start to a phase.
+ *
+ * @param phase The phase (see enum eht_phase).
+ * @param start The timestamp at the start of the phase.
+ * @return The current timestamp, i.e. the start of the next phase.
+ */
+uint64_t eht_instrument_lap(int phase, uint64_t start)
+{
+	uint64_t now = eht_instrument_ticks();
+	eht_stats* s = stats();
+	if(s!=NULL)
+	{
+		s->cycles[phase] += now - start;
+		s->calls[phase]++;
+	}
+	return now;
+}
+
+/**
+ * This function counts one attempt of the rejection loop.
+ *
+ * @param within_bound The number of entries of e = C*z within the bound S.
+ */
+void eht_instrument_attempt(int within_bound)
+{
+	eht_stats* s = stats();
+	if(s!=NULL)
+	{
+		s->attempts++;
+		s->within_bound_histogram[within_bound]++;
+	}
+}
+
+/**
+ * This function counts one signature.
+ *
+ * @param attempts The number of attempts of the rejection loop it took.
+ */
+void eht_instrument_signature(int attempts)
+{
+	eht_stats* s = stats();
+	if(s!=NULL)
+	{
+		s->signatures++;
+		s->attempt_histogram[(attempts<MAX_ATTEMPTS)?attempts:MAX_ATTEMPTS]++;
+	}
+}
+
+/**
+ * This function writes the counters, summed over all threads, as JSON.
+ *
+ * @param f The file to write to.
+ */
+void eht_instrument_write_json(FILE* f)
+{
+	eht_stats total = {0};
+	uint64_t within_bound_histogram[M+1];
+	int threads = 0;
+
+	for(int i=0; i<=M; i++)
+	{
+		within_bound_histogram[i] = 0;
+	}
+
+	pthread_mutex_lock(&all_stats_lock);
+	for(eht_stats* s=all_stats; s!=NULL; s=s->next)
+	{
+		threads++;
+		for(int p=0; p<NUM_PHASES; p++)
+		{
+			total.cycles[p] += s->cycles[p];
+			total.calls[p] += s->calls[p];
+		}
+		total.signatures += s->signatures;
+		total.attempts += s->attempts;
+		for(int i=0; i<=MAX_ATTEMPTS; i++)
+		{
+			total.attempt_histogram[i] += s->attempt_histogram[i];
+		}
+		for(int i=0; i<=M; i++)
+		{
+			within_bound_histogram[i] += s->within_bound_histogram[i];
+		}
+	}
+	pthread_mutex_unlock(&all_stats_lock);
+
+	fprintf(f, "{\n  \"threads\": %d,\n  \"signatures\": %llu,\n  \"attempts\": %llu,\n",
+	        threads, (unsigned long long)total.signatures, (unsigned long long)total.attempts);
+	fprintf(f, "  \"attempts_per_signature\": %.4f,\n", total.signatures ? (double)total.attempts/total.signatures : 0.0);
+
+	fprintf(f, "  \"phases\": {");
+	for(int p=0; p<NUM_PHASES; p++)
+	{
+		fprintf(f, "%s\n    \"%s\": { \"calls\": %llu, \"cycles\": %llu, \"cycles_per_call\": %.1f }", (p==0)?"":",",
+		        PHASE_NAMES[p], (unsigned long long)total.calls[p], (unsigned long long)total.cycles[p],
+		        total.calls[p] ? (double)total.cycles[p]/total.calls[p] : 0.0);
+	}
+	fprintf(f, "\n  },\n");
+
+	// Histograms as {"value": count}, without the empty buckets; the last attempts bucket is "64+"
+	fprintf(f, "  \"attempts_histogram\": {");
+	int first = 1;
+	for(int i=0; i<=MAX_ATTEMPTS; i++)
+	{
+		if(total.attempt_histogram[i]!=0)
+		{
+			fprintf(f, "%s \"%d%s\": %llu", first?"":",", i, (i==MAX_ATTEMPTS)?"+":"", (unsigned long long)total.attempt_histogram[i]);
+			first = 0;
+		}
+	}
+	fprintf(f, " },\n");
+
+	fprintf(f, "  \"within_bound_histogram\": {");
+	first = 1;
+	for(int i=0; i<=M; i++)
+	{
+		if(within_bound_histogram[i]!=0)
+		{
+			fprintf(f, "%s \"%d\": %llu", first?"":",", i, (unsigned long long)within_bound_histogram[i]);
+			first = 0;
+		}
+	}
+	fprintf(f, " }\n}\n");
+}
+
+#endif
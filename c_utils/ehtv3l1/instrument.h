@@ -0,0 +1,47 @@
+#ifndef instrument_h
+#define instrument_h
+
+/**
+ * Optional instrumentation of signing, compiled in with -DEHT_INSTRUMENT (make INSTRUMENT=1) and to nothing otherwise.
+ * It counts the cycles spent in each phase of expand_sk and sig_gen_expanded, the number of attempts of the rejection
+ * loop per signature, and the number of rows of e = C*z within the bound S per attempt. The counters are kept per
+ * thread and summed over all threads by eht_instrument_write_json.
+ */
+
+#ifdef EHT_INSTRUMENT
+
+#include <stdint.h>
+#include <stdio.h>
+
+enum eht_phase
+{
+	PHASE_EXPAND,   // expand_sk
+	PHASE_HASH,     // hash_of_message
+	PHASE_SOLVE_A,  // solve_a
+	PHASE_SOLVE_Z,  // solve_z
+	PHASE_BOUND,    // e = C*z and the count of entries within the bound
+	PHASE_BY,       // x = B*y and the encoding of sm
+	NUM_PHASES
+};
+
+uint64_t eht_instrument_ticks(void);
+uint64_t eht_instrument_lap(int phase, uint64_t start);
+void eht_instrument_attempt(int within_bound);
+void eht_instrument_signature(int attempts);
+void eht_instrument_write_json(FILE* f);
+
+#define INSTRUMENT_START(t) uint64_t t = eht_instrument_ticks()
+#define INSTRUMENT_LAP(phase, t) t = eht_instrument_lap(phase, t)
+#define INSTRUMENT_ATTEMPT(within_bound) eht_instrument_attempt(within_bound)
+#define INSTRUMENT_SIGNATURE(attempts) eht_instrument_signature(attempts)
+
+#else
+
+#define INSTRUMENT_START(t)
+#define INSTRUMENT_LAP(phase, t)
+#define INSTRUMENT_ATTEMPT(within_bound)
+#define INSTRUMENT_SIGNATURE(attempts)
+
+#endif
+
+#endif
@@ -1,17 +0,0 @@
-#include <stdio.h>
-#include <stdlib.h>
-
-// Parameters from the description
-
-const int M = 460; // m
-const int N = 242; // n
-const int Q = 47; // q
-const int K = 2; // k
-const int C = 3; // c
-const int D = 24; // d
-const int TUPPLE[] = {1,7}; // tupple [t1, t2]
-const int NORM1 = 4;  // tau (symbol)
-const int NORM2 = 5; // lambda - tau (symbols)
-const int S = 13; // s
-const int L = 451; // l
-
@@ -1,16 +1,19 @@
 #ifndef parameters_h
 #define parameters_h
 
-extern const int M;
-extern const int N;
-extern const int Q;
-extern const int K;
-extern const int C;
-extern const int D;
-extern const int TUPPLE[];
-extern const int NORM1;
-extern const int NORM2;
-extern const int S;
-extern const int L;
+// The parameter set is chosen at compile time with -DEHT_LEVEL=1, 3 or 5 (make LEVEL=...); the default is l1.
+// Only the l1 parameters (and the l1 arithmetic tables in tables.c) are part of this implementation.
+
+#ifndef EHT_LEVEL
+#define EHT_LEVEL 1
+#endif
+
+#if EHT_LEVEL == 1
+#include "params_l1.h"
+#elif EHT_LEVEL == 3 || EHT_LEVEL == 5
+#error "Only the ehtv3l1 parameter set is available; add a params_l3.h/params_l5.h (and matching tables.c) for this level"
+#else
+#error "EHT_LEVEL must be 1, 3 or 5"
+#endif
 
 #endif
@@ -0,0 +1,27 @@
+#ifndef params_l1_h
+#define params_l1_h
+
+// Parameters from the description, for the EHTv3 l1 parameter set.
+// They are static const rather than extern so that the compiler sees their values in every function that uses them:
+// loop bounds are known and reductions % Q become multiplications.
+// Note that tables.c (the arithmetic tables mod Q) is also specific to Q = 47.
+
+static const int M = 460; // m
+static const int N = 242; // n
+static const int Q = 47; // q
+static const int K = 2; // k
+static const int C = 3; // c
+static const int D = 24; // d
+static const int TUPPLE[] = {1,7}; // tupple [t1, t2]
+static const int NORM1 = 4;  // tau (symbol)
+static const int NORM2 = 5; // lambda - tau (symbols)
+static const int S = 13; // s
+static const int L = 451; // l
+
+// Sizes for api.h
+#define EHT_ALGNAME "ehtv3l1"
+#define EHT_SECRETKEYBYTES 368
+#define EHT_PUBLICKEYBYTES 83490
+#define EHT_BYTES 169
+
+#endif
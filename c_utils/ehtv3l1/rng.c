@@ -12,7 +12,8 @@ You are solely responsible for determining the appropriateness of using and dist
 #include <openssl/evp.h>
 #include <openssl/err.h>
 
-AES256_CTR_DRBG_struct  DRBG_ctx;
+// Thread local, so that several keys can be generated at once (see c_utils/keygen.c)
+__thread AES256_CTR_DRBG_struct  DRBG_ctx;
 
 void    AES256_ECB(unsigned char *key, unsigned char *ctr, unsigned char *buffer);
 
@@ -1,14 +1,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "api.h"
 #include "eht_keygen.h"
 #include "eht_siggen.h"
 #include "eht_sigver.h"
 
-#define CRYPTO_SECRETKEYBYTES 368
-#define CRYPTO_PUBLICKEYBYTES 83490
-#define CRYPTO_BYTES 169
-
 int crypto_sign_keypair(unsigned char *pk, unsigned char *sk)
 {
 	return key_gen(pk, sk);
@@ -0,0 +1,559 @@
+// Native version of fake_sign.py: forges signatures from the partial private key
+// (C, T, B) written by partial_key_recovery.py (JSON or .ehtk), without Sage.
+//
+// Everything that does not depend on the message is prepared once (like
+// PreparedKey in fake_sign.py): an LU factorization of C1, and for the CVP in the
+// non-triangular upper-left block T_ul of T, an LLL-reduced basis of the q-ary
+// lattice spanned by the echelon form of T_ul^T, with its Gram-Schmidt vectors.
+// LLL and Babai's nearest plane run on int64 bases with double Gram-Schmidt data,
+// which is plenty for the small dimension of that lattice (27 for category 1).
+// Each attempt is then an LU solve, a Babai rounding, and peeling off the
+// triangular part of T two rows at a time (get_y_small).
+
+#define _GNU_SOURCE
+
+#include <getopt.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "api.h"
+#include "parameters.h"
+#include "general_functions.h"
+#include "rng.h"
+
+#include "common.h"
+#include "ehtk.h"
+#include "gf47.h"
+
+// Defined in eht_siggen.c
+void mx_to_sm(const unsigned char* m, unsigned long long mlen, unsigned char** x, unsigned char* sm, unsigned long long* smlen);
+
+#define LLL_DELTA 0.99
+// Largest |z_i| accepted for a = T y + z (see get_yz in fake_sign.py)
+#define Z_BOUND 3
+
+struct matrix {
+  int rows, cols;
+  uint8_t* a;
+};
+
+struct forger {
+  struct matrix C, T, B;
+
+  // P C1 = L U
+  uint8_t* C1_lu;
+  int* C1_perm;
+
+  // T_ul is the first ul_rows x ul_cols block of T; below and to the right of it,
+  // T is triangular (tri_cols columns, two rows each).
+  int ul_rows, ul_cols, tri_cols;
+
+  // LLL-reduced lattice basis (ul_rows x ul_rows) and its Gram-Schmidt vectors
+  int64_t* lat;
+  double* lat_gso;
+  double* lat_gso_norm;
+
+  // T_ul y = v for v in the column span of T_ul, with y = Y_piv v[pivots]
+  int npivots;
+  int* pivots;
+  uint8_t* Y_piv;
+};
+
+static int residue(int64_t x) {
+  int r = x % Q;
+  return (r < 0) ? r + Q : r;
+}
+
+static char* read_file(const char* fname) {
+  FILE* fp = fopen(fname, "r");
+  if (fp == NULL) {
+    return NULL;
+  }
+  size_t len = 0, cap = 1 << 20, got;
+  char* buf = malloc(cap);
+  while ((got = fread(buf + len, 1, cap - len - 1, fp)) > 0) {
+    len += got;
+    if (len + 1 == cap) {
+      cap *= 2;
+      buf = realloc(buf, cap);
+    }
+  }
+  buf[len] = '\0';
+  fclose(fp);
+  return buf;
+}
+
+// Parses the matrix stored under "name" in the key JSON (a list of rows).
+// Returns 0 if it is missing or malformed.
+static int parse_matrix(const char* json, const char* name, struct matrix* mat) {
+  char quoted[16];
+  snprintf(quoted, sizeof(quoted), "\"%s\"", name);
+  const char* s = strstr(json, quoted);
+  if (s == NULL || (s = strchr(s + strlen(quoted), '[')) == NULL) {
+    return 0;
+  }
+  s++;
+
+  size_t count = 0, cap = 1024;
+  int rows = 0, cols = -1;
+  mat->a = malloc(cap);
+  while (1) {
+    s += strspn(s, " \t\r\n,");
+    if (*s == ']') {
+      break;
+    }
+    if (*s != '[') {
+      return 0;
+    }
+    s++;
+    int n = 0;
+    while (1) {
+      s += strspn(s, " \t\r\n,");
+      if (*s == ']') {
+        s++;
+        break;
+      }
+      char* end;
+      long x = strtol(s, &end, 10);
+      if (end == s) {
+        return 0;
+      }
+      if (count == cap) {
+        cap *= 2;
+        mat->a = realloc(mat->a, cap);
+      }
+      mat->a[count++] = residue(x);
+      n++;
+      s = end;
+    }
+    if (cols >= 0 && n != cols) {
+      return 0;
+    }
+    cols = n;
+    rows++;
+  }
+  mat->rows = rows;
+  mat->cols = cols;
+  return rows > 0;
+}
+
+// Copies the matrix called name out of an .ehtk key. Returns 0 if it is missing.
+static int copy_matrix(const struct ehtk* key, const char* name, struct matrix* mat) {
+  const uint8_t* a = ehtk_find(key, name, &mat->rows, &mat->cols);
+  if (a == NULL) {
+    return 0;
+  }
+  mat->a = malloc((size_t)mat->rows * mat->cols);
+  memcpy(mat->a, a, (size_t)mat->rows * mat->cols);
+  return 1;
+}
+
+// Reads the partial key from its JSON or .ehtk file. Returns 0 on failure.
+static int read_key(const char* fname, struct forger* f) {
+  if (ehtk_is_ehtk(fname)) {
+    struct ehtk* key = ehtk_open(fname);
+    if (key == NULL) {
+      return 0;
+    }
+    int ok = copy_matrix(key, "C", &f->C) && copy_matrix(key, "T", &f->T) && copy_matrix(key, "B", &f->B);
+    ehtk_close(key);
+    return ok;
+  }
+  char* json = read_file(fname);
+  if (json == NULL) {
+    return 0;
+  }
+  int ok = parse_matrix(json, "C", &f->C) && parse_matrix(json, "T", &f->T) && parse_matrix(json, "B", &f->B);
+  free(json);
+  return ok;
+}
+
+static void gram_schmidt(const int64_t* B, int n, double* Bs, double* norm, double* mu) {
+  for (int i = 0; i < n; i++) {
+    for (int k = 0; k < n; k++) {
+      Bs[i * n + k] = B[i * n + k];
+    }
+    for (int j = 0; j < i; j++) {
+      double d = 0;
+      for (int k = 0; k < n; k++) {
+        d += B[i * n + k] * Bs[j * n + k];
+      }
+      mu[i * n + j] = d / norm[j];
+      for (int k = 0; k < n; k++) {
+        Bs[i * n + k] -= mu[i * n + j] * Bs[j * n + k];
+      }
+    }
+    norm[i] = 0;
+    for (int k = 0; k < n; k++) {
+      norm[i] += Bs[i * n + k] * Bs[i * n + k];
+    }
+  }
+}
+
+// Textbook LLL on the rows of the full-rank basis B (n x n), in place. The
+// Gram-Schmidt data is simply recomputed after every swap.
+static void lll(int64_t* B, int n, double* Bs, double* norm) {
+  double* mu = calloc((size_t)n * n, sizeof(double));
+  gram_schmidt(B, n, Bs, norm, mu);
+  int k = 1;
+  while (k < n) {
+    for (int j = k - 1; j >= 0; j--) {
+      int64_t q = llround(mu[k * n + j]);
+      if (q != 0) {
+        for (int i = 0; i < n; i++) {
+          B[k * n + i] -= q * B[j * n + i];
+        }
+        for (int l = 0; l < j; l++) {
+          mu[k * n + l] -= q * mu[j * n + l];
+        }
+        mu[k * n + j] -= q;
+      }
+    }
+    double m = mu[k * n + k - 1];
+    if (norm[k] >= (LLL_DELTA - m * m) * norm[k - 1]) {
+      k++;
+    } else {
+      for (int i = 0; i < n; i++) {
+        int64_t t = B[k * n + i];
+        B[k * n + i] = B[(k - 1) * n + i];
+        B[(k - 1) * n + i] = t;
+      }
+      gram_schmidt(B, n, Bs, norm, mu);
+      k = (k > 1) ? k - 1 : 1;
+    }
+  }
+  free(mu);
+}
+
+static int prepare(struct forger* f) {
+  const struct matrix* C = &f->C;
+  const struct matrix* T = &f->T;
+  int n = C->rows;
+
+  // a1 = C1**-1 (h - C2 a2)
+  f->C1_lu = malloc((size_t)n * n);
+  f->C1_perm = malloc(n * sizeof(int));
+  for (int i = 0; i < n; i++) {
+    memcpy(f->C1_lu + (size_t)i * n, C->a + (size_t)i * C->cols, n);
+  }
+  if (gf47_lu(f->C1_lu, n, f->C1_perm) != n) {
+    fprintf(stderr, "C1 is not invertible\n");
+    return 0;
+  }
+
+  // What is the length of the non-triangular bit?
+  int i;
+  for (i = 0; i < T->cols; i++) {
+    int col = T->cols - i - 1, zero = 1;
+    for (int r = 0; r < T->rows - 2 * (i + 1) && zero; r++) {
+      zero = (T->a[(size_t)r * T->cols + col] == 0);
+    }
+    if (!zero) {
+      break;
+    }
+  }
+  f->tri_cols = i;
+  f->ul_rows = T->rows - 2 * f->tri_cols;
+  f->ul_cols = T->cols - f->tri_cols;
+  int r = f->ul_rows, c = f->ul_cols;
+
+  // The lattice of a_top that are close to T_ul * y_top: the rows of the echelon
+  // form of T_ul^T, and Q times the unit vectors at its non-pivot columns
+  uint8_t* E = malloc((size_t)c * r);
+  for (int j = 0; j < c; j++) {
+    for (int k = 0; k < r; k++) {
+      E[(size_t)j * r + k] = T->a[(size_t)k * T->cols + j];
+    }
+  }
+  f->pivots = malloc((c + 1) * sizeof(int));
+  if ((f->npivots = gf47_rref(E, c, r, f->pivots)) < 0) {
+    fprintf(stderr, "Memory error.\n");
+    return 0;
+  }
+  f->lat = calloc((size_t)r * r, sizeof(int64_t));
+  for (int j = 0; j < f->npivots; j++) {
+    for (int k = 0; k < r; k++) {
+      f->lat[j * r + k] = E[(size_t)j * r + k];
+    }
+  }
+  for (int k = 0, row = f->npivots, p = 0; k < r; k++) {
+    if (p < f->npivots && f->pivots[p] == k) {
+      p++;
+    } else {
+      f->lat[row++ * r + k] = Q;
+    }
+  }
+  free(E);
+  f->lat_gso = malloc((size_t)r * r * sizeof(double));
+  f->lat_gso_norm = malloc(r * sizeof(double));
+  lll(f->lat, r, f->lat_gso, f->lat_gso_norm);
+
+  // Y_piv (c x npivots) is a right inverse of the pivot rows of T_ul
+  uint8_t* Tp = malloc((size_t)f->npivots * c);
+  uint8_t* id = calloc((size_t)f->npivots * f->npivots, 1);
+  for (int j = 0; j < f->npivots; j++) {
+    memcpy(Tp + (size_t)j * c, T->a + (size_t)f->pivots[j] * T->cols, c);
+    id[j * f->npivots + j] = 1;
+  }
+  f->Y_piv = malloc((size_t)c * f->npivots);
+  int ret = gf47_solve_right(Tp, f->npivots, c, id, f->npivots, f->Y_piv);
+  free(Tp);
+  free(id);
+  if (ret == -2) {
+    fprintf(stderr, "Memory error.\n");
+  }
+  return ret == 0;
+}
+
+// What multiple y of TUPPLE is close to (a0, a1)?
+static int get_y_small(int a0, int a1) {
+  int y;
+  for (y = a0 - Z_BOUND; y <= a0 + Z_BOUND; y++) {
+    int dist = residue(TUPPLE[1] * y - a1);
+    if (dist <= Z_BOUND || dist >= Q - Z_BOUND) {
+      break;
+    }
+  }
+  return (y > a0 + Z_BOUND) ? a0 + Z_BOUND : y;
+}
+
+// One attempt of the rejection loop: y such that a = T y + z with z bounded and
+// C z within the verification bound, for a random a with C a = h. Returns 1 on
+// success, 0 if C z was not small enough, -1 if Babai's rounding was not close
+// enough, and -2 if out of memory.
+static int attempt(const struct forger* f, const uint8_t* h, int* y) {
+  const struct matrix* C = &f->C;
+  const struct matrix* T = &f->T;
+  int rows = C->rows, cols = C->cols, n = f->ul_rows;
+  int a[cols], z[cols];
+  uint8_t a1[rows];
+
+  // Generate a such that C * a = h
+  for (int j = rows; j < cols; j++) {
+    unsigned char b;
+    do {
+      randombytes(&b, 1);
+    } while (b >= 256 / Q * Q);
+    a[j] = b % Q;
+  }
+  for (int i = 0; i < rows; i++) {
+    int acc = h[i];
+    for (int j = rows; j < cols; j++) {
+      acc -= C->a[(size_t)i * cols + j] * a[j];
+    }
+    a1[i] = residue(acc);
+  }
+  if (gf47_lu_solve(f->C1_lu, f->C1_perm, rows, a1, 1) != 0) {
+    return -2;
+  }
+  for (int i = 0; i < rows; i++) {
+    a[i] = a1[i];
+  }
+
+  // Babai's nearest plane: a_top - z_top is a lattice vector close to a_top
+  int64_t r[n];
+  for (int i = 0; i < n; i++) {
+    r[i] = a[i];
+  }
+  for (int i = n - 1; i >= 0; i--) {
+    double d = 0;
+    for (int k = 0; k < n; k++) {
+      d += r[k] * f->lat_gso[i * n + k];
+    }
+    int64_t q = llround(d / f->lat_gso_norm[i]);
+    for (int k = 0; k < n; k++) {
+      r[k] -= q * f->lat[i * n + k];
+    }
+  }
+
+  // y_top with T_ul y_top = a_top - z_top
+  memset(y, 0, T->cols * sizeof(int));
+  for (int j = 0; j < f->ul_cols; j++) {
+    int acc = 0;
+    for (int p = 0; p < f->npivots; p++) {
+      int piv = f->pivots[p];
+      acc += f->Y_piv[j * f->npivots + p] * residue(a[piv] - r[piv]);
+    }
+    y[j] = acc % Q;
+  }
+
+  // z = a - T y, then peel off the triangular part of T
+  for (int i = 0; i < cols; i++) {
+    int acc = a[i];
+    for (int j = 0; j < f->ul_cols; j++) {
+      acc -= T->a[(size_t)i * T->cols + j] * y[j];
+    }
+    z[i] = residue(acc);
+  }
+  for (int t = 0; t < f->tri_cols; t++) {
+    int ind = n + 2 * t, col = f->ul_cols + t;
+    int yi = residue(get_y_small(z[ind], z[ind + 1]));
+    for (int i = 0; i < cols; i++) {
+      z[i] = residue(z[i] - yi * T->a[(size_t)i * T->cols + col]);
+    }
+    y[col] = yi;
+  }
+  for (int i = 0; i < cols; i++) {
+    if (z[i] > Z_BOUND && z[i] < Q - Z_BOUND) {
+      return -1;
+    }
+  }
+
+  // At least L entries of e = C z are at most S
+  int count = 0;
+  for (int i = 0; i < rows; i++) {
+    int e = 0;
+    for (int j = 0; j < cols; j++) {
+      e += C->a[(size_t)i * cols + j] * z[j];
+    }
+    e %= Q;
+    count += (e <= S || e >= Q - S);
+  }
+  return count >= L;
+}
+
+// Forges a signature of msg into sm (of at least mlen + CRYPTO_BYTES bytes).
+// Returns the number of attempts, or -1 if out of memory; *rejected counts those
+// where z was out of bounds.
+static int forge(const struct forger* f, const unsigned char* msg, unsigned long long mlen,
+                 unsigned char* sm, unsigned long long* smlen, int* rejected) {
+  unsigned char** hm = allocate_unsigned_char_matrix_memory(M, 1);
+  uint8_t h[M];
+  int y[f->T.cols];
+  hash_of_message(msg, mlen, hm);
+  for (int i = 0; i < M; i++) {
+    h[i] = hm[i][0];
+  }
+  free_matrix(M, hm);
+
+  int attempts = 0, ret;
+  do {
+    attempts++;
+    if ((ret = attempt(f, h, y)) == -2) {
+      return -1;
+    } else if (ret < 0) {
+      (*rejected)++;
+    }
+  } while (ret != 1);
+
+  // x = B y
+  unsigned char** x = allocate_unsigned_char_matrix_memory(N, 1);
+  for (int i = 0; i < N; i++) {
+    int acc = 0;
+    for (int j = 0; j < f->B.cols; j++) {
+      acc += f->B.a[(size_t)i * f->B.cols + j] * y[j];
+    }
+    x[i][0] = acc % Q;
+  }
+  mx_to_sm(msg, mlen, x, sm, smlen);
+  free_matrix(N, x);
+  return attempts;
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Usage: %s [-s SEED] KEY MESSAGE > SIGNED\n", argv0);
+  fprintf(stderr, "       %s [-s SEED] -m MESSAGES KEY > SIGNATURES\n", argv0);
+  fprintf(stderr, "KEY is the partial key as JSON or .ehtk\n");
+}
+
+int
+main(int argc, char** argv)
+{
+  int opt;
+  unsigned int seed = 3;
+  const char* messages = NULL;
+  while ((opt = getopt(argc, argv, "s:m:")) != -1) {
+    switch (opt) {
+      case 's':
+        seed = strtoul(optarg, NULL, 10);
+        break;
+      case 'm':
+        messages = optarg;
+        break;
+      default:
+        usage(argv[0]);
+        return -1;
+    }
+  }
+  if (optind + (messages ? 1 : 2) != argc) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  struct forger f;
+  memset(&f, 0, sizeof(f));
+  if (!read_key(argv[optind], &f)
+      || f.C.cols != f.T.rows || f.B.cols != f.T.cols || f.B.rows != N || f.C.rows != M) {
+    fprintf(stderr, "Couldn't read <%s> as a partial private key\n", argv[optind]);
+    return -1;
+  }
+  if (!prepare(&f)) {
+    return -1;
+  }
+
+  unsigned char entropy_input[48];
+  memset(entropy_input, 0, sizeof(entropy_input));
+  ((unsigned int*)entropy_input)[0] = seed;
+  randombytes_init(entropy_input, NULL, 256);
+
+  int rejected = 0;
+  if (messages == NULL) {
+    // One message, raw signed message to stdout like fake_sign.py
+    unsigned long long mlen = strlen(argv[optind + 1]), smlen;
+    unsigned char* sm = malloc(mlen + CRYPTO_BYTES);
+    int attempts = forge(&f, (unsigned char*)argv[optind + 1], mlen, sm, &smlen, &rejected);
+    if (attempts < 0) {
+      fprintf(stderr, "Memory error.\n");
+      return -1;
+    }
+    fprintf(stderr, "Signed after %d attempts (%d with z out of bounds)\n", attempts, rejected);
+    report_metric("forged_signatures", 1);
+    report_metric("forge_attempts", attempts);
+    fwrite(sm, 1, smlen, stdout);
+    free(sm);
+    return 0;
+  }
+
+  // One message per line, hex-encoded signed messages like eht_siggen
+  FILE* fp = (strcmp(messages, "-") == 0) ? stdin : fopen(messages, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "Couldn't open <%s> for read\n", messages);
+    return -1;
+  }
+  char* line = NULL;
+  size_t linecap = 0;
+  ssize_t len;
+  long count = 0, attempts = 0;
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  while ((len = getline(&line, &linecap, fp)) > 0) {
+    if (line[len - 1] == '\n') {
+      line[--len] = '\0';
+    }
+    unsigned long long smlen;
+    unsigned char* sm = malloc(len + CRYPTO_BYTES);
+    int n = forge(&f, (unsigned char*)line, len, sm, &smlen, &rejected);
+    if (n < 0) {
+      fprintf(stderr, "Memory error.\n");
+      return -1;
+    }
+    attempts += n;
+    fprintBstr(stdout, "", sm, smlen);
+    free(sm);
+    count++;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double elapsed = (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
+  fprintf(stderr, "Forged %ld signatures in %.2f s (%.1f per second)\n", count, elapsed, count / elapsed);
+  fprintf(stderr, "%ld attempts, acceptance rate %.3f (%d attempts with z out of bounds)\n",
+          attempts, count / (double)(attempts ? attempts : 1), rejected);
+  report_metric("forged_signatures", count);
+  report_metric("forge_attempts", attempts);
+  free(line);
+  return 0;
+}
@@ -0,0 +1,411 @@
+// Dense linear algebra over GF(47). See gf47.h.
+
+#include "gf47.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define Q GF47_Q
+
+// Number of pivots whose row updates are collected before they are applied to
+// the remaining rows in one pass (see echelon)
+#define BLOCK 8
+
+int gf47_inv(int a) {
+  int r = 1;
+  a %= Q;
+  if (a < 0) {
+    a += Q;
+  }
+  for (int e = Q - 2; e > 0; e >>= 1) {
+    if (e & 1) {
+      r = r * a % Q;
+    }
+    a = a * a % Q;
+  }
+  return r;
+}
+
+static uint32_t* widen(const uint8_t* a, long count, long stride, long rows, long cols) {
+  // Copies the rows x cols matrix a (with row stride stride) into the first
+  // cols columns of a new rows x count/rows working matrix
+  uint32_t* w = calloc(count, sizeof(uint32_t));
+  if (w == NULL) {
+    return NULL;
+  }
+  long n = count / rows;
+  for (long i = 0; i < rows; i++) {
+    for (long j = 0; j < cols; j++) {
+      w[i * n + j] = a[i * stride + j];
+    }
+  }
+  return w;
+}
+
+static void reduce(uint32_t* restrict row, int from, int n) {
+  for (int j = from; j < n; j++) {
+    row[j] %= Q;
+  }
+}
+
+// row[j] += f * piv[j] for from <= j < n, without reducing
+static void axpy(uint32_t* restrict row, const uint32_t* restrict piv, uint32_t f, int from, int n) {
+  for (int j = from; j < n; j++) {
+    row[j] += f * piv[j];
+  }
+}
+
+static void swap_rows(uint32_t* w, int n, int i, int j) {
+  if (i == j) {
+    return;
+  }
+  for (int c = 0; c < n; c++) {
+    uint32_t t = w[i * n + c];
+    w[i * n + c] = w[j * n + c];
+    w[j * n + c] = t;
+  }
+}
+
+// Brings w (m x n) to row echelon form, with every pivot row fully reduced and
+// scaled so that its leading entry is 1. Returns the rank.
+//
+// Pivots are processed in groups of up to BLOCK. Within a group, only the column
+// currently searched for a pivot is brought up to date in the rows below; the
+// multipliers of the group are recorded in f, and once the group is complete all
+// of its row updates are applied to the remaining columns of the remaining rows
+// in one pass, while each row is in cache.
+static int echelon(uint32_t* w, int m, int n, int* pivots) {
+  uint32_t* f = malloc((size_t)m * BLOCK * sizeof(uint32_t));
+  if (f == NULL) {
+    return -1;
+  }
+  int r = 0, c = 0;
+
+  while (r < m && c < n) {
+    int rstart = r;
+    int k = 0;
+    memset(f, 0, (size_t)m * BLOCK * sizeof(uint32_t));
+
+    for (; k < BLOCK && r < m && c < n; c++) {
+      // Current value of column c in the rows that have no pivot yet
+      int p = -1;
+      for (int i = r; i < m; i++) {
+        uint32_t v = w[i * n + c];
+        for (int t = 0; t < k; t++) {
+          v += f[i * BLOCK + t] * w[(rstart + t) * n + c];
+        }
+        w[i * n + c] = v % Q;
+        if (p < 0 && w[i * n + c] != 0) {
+          p = i;
+        }
+      }
+      if (p < 0) {
+        continue;
+      }
+
+      // Bring the new pivot row up to date, reduce and normalize it
+      swap_rows(w, n, p, r);
+      for (int t = 0; t < BLOCK; t++) {
+        uint32_t tmp = f[p * BLOCK + t];
+        f[p * BLOCK + t] = f[r * BLOCK + t];
+        f[r * BLOCK + t] = tmp;
+      }
+      uint32_t* piv = w + (long)r * n;
+      for (int t = 0; t < k; t++) {
+        axpy(piv, w + (long)(rstart + t) * n, f[r * BLOCK + t], c + 1, n);
+      }
+      reduce(piv, c + 1, n);
+      uint32_t inv = gf47_inv(piv[c]);
+      for (int j = c; j < n; j++) {
+        piv[j] = piv[j] * inv % Q;
+      }
+
+      // The rows below only get their multiplier for now; column c is cleared right away
+      for (int i = r + 1; i < m; i++) {
+        f[i * BLOCK + k] = (Q - w[i * n + c]) % Q;
+        w[i * n + c] = 0;
+      }
+      if (pivots != NULL) {
+        pivots[r] = c;
+      }
+      r++;
+      k++;
+    }
+
+    // Apply the updates of the whole group to the rest of the matrix
+    for (int i = r; i < m; i++) {
+      uint32_t* row = w + (long)i * n;
+      for (int t = 0; t < k; t++) {
+        if (f[i * BLOCK + t] != 0) {
+          axpy(row, w + (long)(rstart + t) * n, f[i * BLOCK + t], c, n);
+        }
+      }
+    }
+  }
+
+  free(f);
+  return r;
+}
+
+// Clears the entries above the pivots of an echelon form computed by echelon
+static void back_substitute(uint32_t* w, int n, int rank, const int* pivots) {
+  for (int k = rank - 1; k >= 0; k--) {
+    uint32_t* piv = w + (long)k * n;
+    int c = pivots[k];
+    reduce(piv, c + 1, n);
+    for (int i = 0; i < k; i++) {
+      uint32_t g = w[(long)i * n + c] % Q;
+      if (g != 0) {
+        axpy(w + (long)i * n, piv, Q - g, c + 1, n);
+      }
+      w[(long)i * n + c] = 0;
+    }
+  }
+}
+
+static void narrow(const uint32_t* w, uint8_t* a, long count) {
+  for (long i = 0; i < count; i++) {
+    a[i] = w[i] % Q;
+  }
+}
+
+int gf47_mul(const uint8_t* a, const uint8_t* b, uint8_t* c, int m, int k, int n) {
+  uint32_t* acc = malloc(n * sizeof(uint32_t));
+  if (acc == NULL) {
+    return -1;
+  }
+  for (int i = 0; i < m; i++) {
+    memset(acc, 0, n * sizeof(uint32_t));
+    for (int l = 0; l < k; l++) {
+      uint32_t x = a[(long)i * k + l];
+      if (x == 0) {
+        continue;
+      }
+      const uint8_t* brow = b + (long)l * n;
+      for (int j = 0; j < n; j++) {
+        acc[j] += x * brow[j];
+      }
+    }
+    for (int j = 0; j < n; j++) {
+      c[(long)i * n + j] = acc[j] % Q;
+    }
+  }
+  free(acc);
+  return 0;
+}
+
+int gf47_rref(uint8_t* a, int m, int n, int* pivots) {
+  uint32_t* w = widen(a, (long)m * n, n, m, n);
+  int* piv = malloc((m < n ? m : n) * sizeof(int) + sizeof(int));
+  if (w == NULL || piv == NULL) {
+    free(w);
+    free(piv);
+    return -1;
+  }
+  int rank = echelon(w, m, n, piv);
+  if (rank < 0) {
+    free(piv);
+    free(w);
+    return -1;
+  }
+  back_substitute(w, n, rank, piv);
+  narrow(w, a, (long)m * n);
+  if (pivots != NULL) {
+    memcpy(pivots, piv, rank * sizeof(int));
+  }
+  free(piv);
+  free(w);
+  return rank;
+}
+
+int gf47_rank(const uint8_t* a, int m, int n) {
+  uint32_t* w = widen(a, (long)m * n, n, m, n);
+  if (w == NULL) {
+    return -1;
+  }
+  int rank = echelon(w, m, n, NULL);
+  free(w);
+  return rank;
+}
+
+int gf47_right_kernel(const uint8_t* a, int m, int n, uint8_t* k) {
+  uint8_t* r = malloc((long)m * n);
+  int* pivots = malloc(n * sizeof(int));
+  int rank = -1;
+  if (r != NULL && pivots != NULL) {
+    memcpy(r, a, (long)m * n);
+    rank = gf47_rref(r, m, n, pivots);
+  }
+  if (rank < 0) {
+    free(pivots);
+    free(r);
+    return -1;
+  }
+
+  // One basis vector per free column f: 1 in column f, minus column f of r at the pivots
+  int dim = 0;
+  for (int col = 0, p = 0; col < n; col++) {
+    if (p < rank && pivots[p] == col) {
+      p++;
+      continue;
+    }
+    uint8_t* v = k + (long)dim * n;
+    memset(v, 0, n);
+    v[col] = 1;
+    for (int i = 0; i < rank; i++) {
+      v[pivots[i]] = (Q - r[(long)i * n + col]) % Q;
+    }
+    dim++;
+  }
+  // Same (echelonized) basis as Sage's left_kernel/right_kernel
+  if (dim > 0 && gf47_rref(k, dim, n, NULL) < 0) {
+    dim = -1;
+  }
+
+  free(pivots);
+  free(r);
+  return dim;
+}
+
+int gf47_solve_right(const uint8_t* a, int m, int n, const uint8_t* b, int nb, uint8_t* x) {
+  int na = n + nb;
+  uint8_t* aug = malloc((long)m * na);
+  int* pivots = malloc(na * sizeof(int));
+  int rank = -1;
+  if (aug != NULL && pivots != NULL) {
+    for (int i = 0; i < m; i++) {
+      memcpy(aug + (long)i * na, a + (long)i * n, n);
+      memcpy(aug + (long)i * na + n, b + (long)i * nb, nb);
+    }
+    rank = gf47_rref(aug, m, na, pivots);
+  }
+  if (rank < 0) {
+    free(pivots);
+    free(aug);
+    return -2;
+  }
+
+  int ret = 0;
+  memset(x, 0, (long)n * nb);
+  for (int i = 0; i < rank; i++) {
+    if (pivots[i] >= n) {
+      // A pivot in b means b is not in the column span of a
+      ret = -1;
+      break;
+    }
+    memcpy(x + (long)pivots[i] * nb, aug + (long)i * na + n, nb);
+  }
+
+  free(pivots);
+  free(aug);
+  return ret;
+}
+
+int gf47_inverse(const uint8_t* a, int n, uint8_t* inv) {
+  uint8_t* id = calloc((long)n * n, 1);
+  if (id == NULL) {
+    return -2;
+  }
+  for (int i = 0; i < n; i++) {
+    id[(long)i * n + i] = 1;
+  }
+  // Square systems have a solution for every right hand side iff a is invertible
+  int rank = gf47_rank(a, n, n);
+  int ret = (rank < 0) ? -2 : (rank == n) ? gf47_solve_right(a, n, n, id, n, inv) : -1;
+  free(id);
+  return ret;
+}
+
+int gf47_lu(uint8_t* a, int n, int* perm) {
+  uint32_t* w = widen(a, (long)n * n, n, n, n);
+  if (w == NULL) {
+    return -1;
+  }
+  for (int i = 0; i < n; i++) {
+    perm[i] = i;
+  }
+
+  int k;
+  for (k = 0; k < n; k++) {
+    int p = -1;
+    for (int i = k; i < n; i++) {
+      w[(long)i * n + k] %= Q;
+      if (p < 0 && w[(long)i * n + k] != 0) {
+        p = i;
+      }
+    }
+    if (p < 0) {
+      break;
+    }
+    swap_rows(w, n, p, k);
+    int t = perm[p];
+    perm[p] = perm[k];
+    perm[k] = t;
+
+    uint32_t* piv = w + (long)k * n;
+    reduce(piv, k, n);
+    uint32_t inv = gf47_inv(piv[k]);
+    for (int i = k + 1; i < n; i++) {
+      uint32_t* row = w + (long)i * n;
+      uint32_t l = row[k] % Q * inv % Q;
+      row[k] = l;
+      if (l != 0) {
+        axpy(row, piv, Q - l, k + 1, n);
+      }
+    }
+  }
+
+  narrow(w, a, (long)n * n);
+  free(w);
+  return k;
+}
+
+int gf47_lu_solve(const uint8_t* lu, const int* perm, int n, uint8_t* b, int nb) {
+  uint32_t* y = malloc((long)n * nb * sizeof(uint32_t));
+  uint32_t* acc = malloc(nb * sizeof(uint32_t));
+  if (y == NULL || acc == NULL) {
+    free(acc);
+    free(y);
+    return -1;
+  }
+
+  // L y = P b
+  for (int i = 0; i < n; i++) {
+    const uint8_t* l = lu + (long)i * n;
+    for (int c = 0; c < nb; c++) {
+      acc[c] = b[(long)perm[i] * nb + c];
+    }
+    for (int j = 0; j < i; j++) {
+      if (l[j] != 0) {
+        axpy(acc, y + (long)j * nb, Q - l[j], 0, nb);
+      }
+    }
+    for (int c = 0; c < nb; c++) {
+      y[(long)i * nb + c] = acc[c] % Q;
+    }
+  }
+
+  // U x = y
+  for (int i = n - 1; i >= 0; i--) {
+    const uint8_t* u = lu + (long)i * n;
+    for (int c = 0; c < nb; c++) {
+      acc[c] = y[(long)i * nb + c];
+    }
+    for (int j = i + 1; j < n; j++) {
+      if (u[j] != 0) {
+        axpy(acc, y + (long)j * nb, Q - u[j], 0, nb);
+      }
+    }
+    uint32_t inv = gf47_inv(u[i]);
+    for (int c = 0; c < nb; c++) {
+      y[(long)i * nb + c] = acc[c] % Q * inv % Q;
+    }
+  }
+
+  for (long i = 0; i < (long)n * nb; i++) {
+    b[i] = y[i];
+  }
+  free(acc);
+  free(y);
+  return 0;
+}
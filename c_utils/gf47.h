@@ -0,0 +1,51 @@
+#ifndef gf47_h
+#define gf47_h
+
+#include <stdint.h>
+
+// Dense linear algebra over GF(47), for partial_key_recovery.py and fake_sign.py
+// (through gf47.py). All matrices are contiguous, row-major arrays of residues
+// 0..46 stored as uint8_t.
+//
+// Internally, rows are kept in 32-bit accumulators and only reduced mod 47 when
+// they are needed as pivot rows or at the very end. Every elimination step adds
+// at most 46*46 to an entry, so entries cannot overflow for any matrix shape used
+// here, and the inner loops are plain multiply-adds that the compiler vectorizes.
+
+#define GF47_Q 47
+
+int  gf47_inv(int a);
+
+// Functions that allocate scratch memory return -1 (or -2 where -1 already has a
+// meaning) if that fails.
+
+// c (m x n) = a (m x k) * b (k x n). Returns 0.
+int  gf47_mul(const uint8_t* a, const uint8_t* b, uint8_t* c, int m, int k, int n);
+
+// Reduced row echelon form, in place. Returns the rank; pivots (if not NULL)
+// receives the pivot column of each nonzero row.
+int  gf47_rref(uint8_t* a, int m, int n, int* pivots);
+int  gf47_rank(const uint8_t* a, int m, int n);
+
+// Basis of the right kernel of a (m x n), in reduced row echelon form, written
+// as the rows of k (at most n x n). Returns the dimension of the kernel.
+int  gf47_right_kernel(const uint8_t* a, int m, int n, uint8_t* k);
+
+// Solves a x = b for x (n x nb), with b (m x nb). Free variables are set to 0.
+// Returns 0, or -1 if there is no solution (-2 if out of memory).
+int  gf47_solve_right(const uint8_t* a, int m, int n, const uint8_t* b, int nb, uint8_t* x);
+
+// inv = a^-1 for a square a (n x n). Returns 0, or -1 if a is singular (-2 if out of memory).
+int  gf47_inverse(const uint8_t* a, int n, uint8_t* inv);
+
+// LU decomposition with partial pivoting, in place: P a = L U, where L is unit lower
+// triangular (stored below the diagonal) and row i of P a is row perm[i] of a.
+// Returns the rank of the leading columns that could be eliminated (n iff a is invertible),
+// or -1 if out of memory.
+int  gf47_lu(uint8_t* a, int n, int* perm);
+
+// Solves a x = b in place for b (n x nb), using the output of gf47_lu on an invertible a.
+// Returns 0.
+int  gf47_lu_solve(const uint8_t* lu, const int* perm, int n, uint8_t* b, int nb);
+
+#endif
@@ -18,6 +18,7 @@ Modified July 2023 by Keegan Ryan.
 #include "parameters.h"
 #include "general_functions.h"
 #include "common.h"
+#include "libeht.h"
 
 #define KAT_SUCCESS          0
 #define KAT_FILE_OPEN_ERROR -1
@@ -29,7 +30,7 @@ char    AlgName[] = "ehtv3l1";
 int
 main(int argc, char** argv)
 {
-    unsigned char** h;
+    uint8_t* h;
 
     // Read the entire stdin into a buffer
     unsigned char* msg = NULL;
@@ -45,13 +46,12 @@ main(int argc, char** argv)
     }
 
     // HASH of Message
-    h = allocate_unsigned_char_matrix_memory(M, 1);
-    hash_of_message(msg, mlen, h);
+    h = malloc(M);
+    eht_hash(msg, mlen, h);
 
     // Output
-    for (unsigned int i = 0; i < M; i++) {
-      char v = h[i][0];
-      fwrite(&v, 1, 1, stdout);
-    }
+    fwrite(h, 1, M, stdout);
+    free(h);
+    free(msg);
     return 0;
 }
@@ -6,10 +6,15 @@ NIST-developed software is expressly provided "AS IS." NIST MAKES NO WARRANTY OF
 You are solely responsible for determining the appropriateness of using and distributing the software and you assume all risks associated with its use, including but not limited to the risks and costs of program errors, compliance with applicable laws, damage to or loss of data, programs or equipment, and the unavailability or interruption of operation. This software is not intended to be used in any situation where a failure could cause risk of injury or damage to property. The software developed by NIST employees is not subject to copyright protection within the United States.
 */
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "rng.h"
 #include "api.h"
 
@@ -20,65 +25,61 @@ You are solely responsible for determining the appropriateness of using and dist
 #define KAT_DATA_ERROR      -3
 #define KAT_CRYPTO_FAILURE  -4
 
+#define KAT_COUNT          100
+
 char    AlgName[] = "ehtv3l1";
 
-int
-main(int argc, char** argv)
+// We wish to regenerate the private keys found in the KATs.
+// These keys are generated by first seeding a PRNG with fixed entropy input,
+// then generating 100 seeds and messages. We call the PRNG in the same way
+// to recover the secret seeds at indices FIRST..LAST (in one pass).
+static void
+kat_seeds(unsigned int first, unsigned int last, unsigned char seeds[][48])
 {
-    char                fn_sk[32], fn_pk[32];
-    FILE                *fp_sk, *fp_pk;
     unsigned char       seed[48];
     unsigned char       msg[3300];
     unsigned char       entropy_input[48];
-    unsigned char       *m, *sm, *m1;
-    unsigned long long  mlen, smlen, mlen1;
-    unsigned char       pk[CRYPTO_PUBLICKEYBYTES], sk[CRYPTO_SECRETKEYBYTES];
-    int                 ret_val;
 
-    // Get key index to create
-    unsigned int key_idx = 0;
-    if (argc >= 2) {
-      sscanf(argv[1], "%u", &key_idx);
-      if (key_idx >= 100) {
-	key_idx = 0;
-      }
+    for (int i=0; i<48; i++)
+        entropy_input[i] = i;
+    randombytes_init(entropy_input, NULL, 256);
+    for (unsigned int i=0; i<=last; i++) {
+        randombytes(seed, 48);
+        randombytes(msg, 33*(i+1));
+        if (i >= first)
+            memcpy(seeds[i-first], seed, 48);
     }
+}
+
+// Regenerate the key with KAT seed SEED and write it to FN_SK and FN_PK.
+// The DRBG state is thread local (see rng.c), so this can run on several threads at once.
+static int
+write_keypair(const unsigned char *seed, const char *fn_sk, const char *fn_pk)
+{
+    FILE                *fp_sk, *fp_pk;
+    unsigned char       seed_copy[48];
+    unsigned char       pk[CRYPTO_PUBLICKEYBYTES], sk[CRYPTO_SECRETKEYBYTES];
+    int                 ret_val;
 
     // Create files for the secret key, public key, and signatures.
-    sprintf(fn_sk, "private.sk");
     if ( (fp_sk = fopen(fn_sk, "w")) == NULL ) {
         fprintf(stderr, "Couldn't open <%s> for write\n", fn_sk);
         return KAT_FILE_OPEN_ERROR;
     }
-    sprintf(fn_pk, "public.pk");
     if ( (fp_pk = fopen(fn_pk, "w")) == NULL ) {
         fprintf(stderr, "Couldn't open <%s> for write\n", fn_pk);
+        fclose(fp_sk);
         return KAT_FILE_OPEN_ERROR;
     }
 
-    printf("Generating KAT key at index %d\n", key_idx);
-
-    // We wish to regenerate one of the private keys found in the KATs.
-    // These keys are generated by first seeding a PRNG with fixed entropy input,
-    // then generating 100 seeds and messages. We call the PRNG in the same way
-    // to recover the secret seed at index KEY_IDX
-    for (int i=0; i<48; i++)
-        entropy_input[i] = i;
-    randombytes_init(entropy_input, NULL, 256);
-    for (int i=0; i<100; i++) {
-        randombytes(seed, 48);
-        mlen = 33*(i+1);
-        randombytes(msg, mlen);
-	if (i == key_idx) {
-	  break;
-	}
-    }
-
     // This seed is used to reseed the PRNG before generating the key.
     // We regenerate the public/private keypair from the KAT.
-    randombytes_init(seed, NULL, 256);
+    memcpy(seed_copy, seed, 48);
+    randombytes_init(seed_copy, NULL, 256);
     if ( (ret_val = crypto_sign_keypair(pk, sk)) != 0) {
       fprintf(stderr, "crypto_sign_keypair returned <%d>\n", ret_val);
+      fclose(fp_sk);
+      fclose(fp_pk);
       return KAT_CRYPTO_FAILURE;
     }
 
@@ -89,6 +90,125 @@ main(int argc, char** argv)
     // Save the public key to a file.
     fwrite(pk, sizeof(unsigned char), CRYPTO_PUBLICKEYBYTES, fp_pk);
     fclose(fp_pk);
-        
+
     return KAT_SUCCESS;
 }
+
+// Keys FIRST..LAST are handed out to the worker threads one at a time
+typedef struct {
+    unsigned int        first, last, next;
+    unsigned char       (*seeds)[48];
+    const char          *outdir;
+    int                 ret_val;
+    pthread_mutex_t     lock;
+} batch;
+
+static void*
+batch_worker(void *arg)
+{
+    batch               *b = arg;
+    char                *fn_sk, *fn_pk;
+
+    for (;;) {
+        pthread_mutex_lock(&b->lock);
+        unsigned int key_idx = b->next++;
+        pthread_mutex_unlock(&b->lock);
+        if (key_idx > b->last)
+            break;
+
+        if (asprintf(&fn_sk, "%s/%u.sk", b->outdir, key_idx) < 0 ||
+            asprintf(&fn_pk, "%s/%u.pk", b->outdir, key_idx) < 0) {
+            fprintf(stderr, "Memory error.\n");
+            exit(-1);
+        }
+        printf("Generating KAT key at index %u\n", key_idx);
+        int ret_val = write_keypair(b->seeds[key_idx - b->first], fn_sk, fn_pk);
+        free(fn_sk);
+        free(fn_pk);
+
+        if (ret_val != KAT_SUCCESS) {
+            pthread_mutex_lock(&b->lock);
+            b->ret_val = ret_val;
+            pthread_mutex_unlock(&b->lock);
+        }
+    }
+    return NULL;
+}
+
+static void
+usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [KEY_INDEX]\n"
+                    "       %s --range FIRST-LAST --outdir DIR [-t THREADS]\n", argv0, argv0);
+}
+
+int
+main(int argc, char** argv)
+{
+    static const struct option long_options[] = {
+        { "range",   required_argument, NULL, 'r' },
+        { "outdir",  required_argument, NULL, 'o' },
+        { "threads", required_argument, NULL, 't' },
+        { NULL, 0, NULL, 0 }
+    };
+    const char          *range = NULL, *outdir = NULL;
+    int                 nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    int                 opt;
+
+    while ((opt = getopt_long(argc, argv, "r:o:t:", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'r': range = optarg; break;
+        case 'o': outdir = optarg; break;
+        case 't': nthreads = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return KAT_DATA_ERROR;
+        }
+    }
+
+    if (range == NULL) {
+        if (outdir != NULL || argc - optind > 1) {
+            usage(argv[0]);
+            return KAT_DATA_ERROR;
+        }
+
+        // Get key index to create
+        unsigned int key_idx = 0;
+        if (optind < argc) {
+          sscanf(argv[optind], "%u", &key_idx);
+          if (key_idx >= KAT_COUNT) {
+            key_idx = 0;
+          }
+        }
+
+        unsigned char seed[1][48];
+        printf("Generating KAT key at index %d\n", key_idx);
+        kat_seeds(key_idx, key_idx, seed);
+        return write_keypair(seed[0], "private.sk", "public.pk");
+    }
+
+    unsigned int first, last;
+    if (outdir == NULL || optind != argc || nthreads < 1 ||
+        sscanf(range, "%u-%u", &first, &last) != 2 || first > last || last >= KAT_COUNT) {
+        usage(argv[0]);
+        return KAT_DATA_ERROR;
+    }
+
+    batch b = { .first = first, .last = last, .next = first, .outdir = outdir, .ret_val = KAT_SUCCESS };
+    b.seeds = malloc((last - first + 1) * sizeof(*b.seeds));
+    pthread_mutex_init(&b.lock, NULL);
+    kat_seeds(first, last, b.seeds);
+
+    if (nthreads > (int)(last - first + 1))
+        nthreads = last - first + 1;
+    pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+    for (int i = 0; i < nthreads; i++)
+        pthread_create(&threads[i], NULL, batch_worker, &b);
+    for (int i = 0; i < nthreads; i++)
+        pthread_join(threads[i], NULL);
+
+    free(threads);
+    free(b.seeds);
+    pthread_mutex_destroy(&b.lock);
+    return b.ret_val;
+}
@@ -0,0 +1,146 @@
+// See libeht.h.
+
+#include "libeht.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "api.h"
+#include "parameters.h"
+#include "general_functions.h"
+#include "eht_siggen.h"
+
+// Defined in eht_sigver.c
+void pk_to_A(const unsigned char *pk, unsigned char **A);
+void sm_to_mx(const unsigned char* sm, unsigned long long smlen, unsigned char* m, unsigned long long* mlen, unsigned char** x);
+
+struct eht_key {
+  expanded_sk esk;
+};
+
+int eht_param_M(void) { return M; }
+int eht_param_N(void) { return N; }
+int eht_param_Q(void) { return Q; }
+
+int eht_param_sig_bytes(void) {
+  return (int)ceil(N * log(Q) / log(256));
+}
+
+void eht_hash(const unsigned char* m, unsigned long long mlen, uint8_t* h) {
+  unsigned char** hm = allocate_unsigned_char_matrix_memory(M, 1);
+  hash_of_message(m, mlen, hm);
+  for (int i = 0; i < M; i++) {
+    h[i] = hm[i][0];
+  }
+  free_matrix(M, hm);
+}
+
+void eht_hash_batch(const unsigned char* m, size_t mlen, size_t count, uint8_t* h) {
+  for (size_t k = 0; k < count; k++) {
+    eht_hash(m + k * mlen, mlen, h + k * M);
+  }
+}
+
+void eht_pk_to_A(const unsigned char* pk, uint8_t* A) {
+  unsigned char** Am = allocate_unsigned_char_matrix_memory(M, N);
+  pk_to_A(pk, Am);
+  for (int i = 0; i < M; i++) {
+    for (int j = 0; j < N; j++) {
+      A[i * N + j] = Am[i][j];
+    }
+  }
+  free_matrix(M, Am);
+}
+
+// e (M) = h - A x mod Q for the signed message sm. Returns -1 if sm is shorter than a signature.
+static int cz_of(const uint8_t* A, const unsigned char* sm, unsigned long long smlen, uint8_t* e) {
+  int size_char = eht_param_sig_bytes();
+  if (smlen < (unsigned long long)size_char) {
+    return -1;
+  }
+  unsigned char* m = malloc(smlen - size_char + 1);
+  unsigned long long mlen;
+  unsigned char** x = allocate_unsigned_char_matrix_memory(N, 1);
+  uint8_t* h = malloc(M);
+  sm_to_mx(sm, smlen, m, &mlen, x);
+  eht_hash(m, mlen, h);
+
+  for (int i = 0; i < M; i++) {
+    int ax = 0;
+    for (int j = 0; j < N; j++) {
+      ax += A[i * N + j] * x[j][0];
+    }
+    e[i] = s_mod_q(h[i] - ax % Q);
+  }
+
+  free(h);
+  free_matrix(N, x);
+  free(m);
+  return 0;
+}
+
+int eht_verify_A(const uint8_t* A, const unsigned char* sm, unsigned long long smlen) {
+  // Same check as sig_ver, without decoding the public key every time
+  uint8_t e[M];
+  if (cz_of(A, sm, smlen, e) != 0) {
+    return -1;
+  }
+  int within_bound = 0;
+  for (int i = 0; i < M; i++) {
+    if (e[i] <= S || e[i] >= Q - S) {
+      within_bound++;
+    }
+  }
+  return (within_bound >= L) ? 0 : -1;
+}
+
+size_t eht_verify_batch(const uint8_t* A, const unsigned char* sm, size_t smlen, size_t count, uint8_t* ok) {
+  size_t valid = 0;
+  for (size_t k = 0; k < count; k++) {
+    int v = (eht_verify_A(A, sm + k * smlen, smlen) == 0);
+    valid += v;
+    if (ok != NULL) {
+      ok[k] = v;
+    }
+  }
+  return valid;
+}
+
+void eht_cz_batch(const uint8_t* A, const unsigned char* sm, size_t smlen, size_t count, uint8_t* cz) {
+  for (size_t k = 0; k < count; k++) {
+    if (cz_of(A, sm + k * smlen, smlen, cz + k * M) != 0) {
+      memset(cz + k * M, 0, M);
+    }
+  }
+}
+
+eht_key* eht_expand_key(const unsigned char* sk) {
+  eht_key* key = malloc(sizeof(*key));
+  if (key == NULL) {
+    return NULL;
+  }
+  if (expand_sk(sk, &key->esk) != 0) {
+    free(key);
+    return NULL;
+  }
+  return key;
+}
+
+void eht_free_key(eht_key* key) {
+  if (key != NULL) {
+    free_expanded_sk(&key->esk);
+    free(key);
+  }
+}
+
+int eht_sign_batch(const eht_key* key, const unsigned char* m, size_t mlen, size_t count, unsigned char* sm) {
+  size_t smlen = mlen + eht_param_sig_bytes();
+  for (size_t k = 0; k < count; k++) {
+    unsigned long long len;
+    if (sig_gen_expanded(sm + k * smlen, &len, m + k * mlen, mlen, &key->esk) != 0) {
+      return -2;
+    }
+  }
+  return 0;
+}
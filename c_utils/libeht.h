@@ -0,0 +1,61 @@
+#ifndef libeht_h
+#define libeht_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+// libeht: the EHTv3 reference implementation as a library (libeht.a and
+// libeht.so), for the c_utils tools and for other languages (see eht.py).
+//
+// Matrices are contiguous, row-major arrays of residues mod Q stored as
+// uint8_t. All buffers belong to the caller. The batch functions work on COUNT
+// records of equal length stored one after another (e.g. the rows of a 2D
+// NumPy array): messages of MLEN bytes, signed messages of SMLEN bytes, and
+// vectors of M residues.
+
+// Parameters of the compiled-in parameter set
+int  eht_param_M(void);
+int  eht_param_N(void);
+int  eht_param_Q(void);
+// Size of a signature: a signed message is this many bytes followed by the message
+int  eht_param_sig_bytes(void);
+
+// h (M) = hash_of_message(m)
+void eht_hash(const unsigned char* m, unsigned long long mlen, uint8_t* h);
+
+// h (COUNT x M): the hashes of COUNT messages of MLEN bytes
+void eht_hash_batch(const unsigned char* m, size_t mlen, size_t count, uint8_t* h);
+
+// Decodes the public key pk (CRYPTO_PUBLICKEYBYTES bytes) into A (M x N)
+void eht_pk_to_A(const unsigned char* pk, uint8_t* A);
+
+// Verifies the signed message sm like crypto_sign_open, but against an already
+// decoded A. Returns 0 if the signature is valid, -1 if not.
+int  eht_verify_A(const uint8_t* A, const unsigned char* sm, unsigned long long smlen);
+
+// Verifies COUNT signed messages of SMLEN bytes against A. If ok is not NULL,
+// ok[i] is 1 if signed message i is valid and 0 if not. Returns the number of
+// valid ones.
+size_t eht_verify_batch(const uint8_t* A, const unsigned char* sm, size_t smlen, size_t count, uint8_t* ok);
+
+// cz (COUNT x M): e = h - A x mod Q for COUNT signed messages of SMLEN bytes
+// (signature x of message hash h), which is C z for genuine signatures. Rows of
+// signed messages shorter than a signature are set to 0.
+void eht_cz_batch(const uint8_t* A, const unsigned char* sm, size_t smlen, size_t count, uint8_t* cz);
+
+// A secret key expanded once for signing many messages: the matrices that
+// crypto_sign would otherwise derive from the seed for every message, and the
+// state of the DRBG after deriving them. Signing only reads the key, and the
+// DRBG state is per thread, so threads can share one expanded key.
+typedef struct eht_key eht_key;
+
+// Expands the secret key sk (CRYPTO_SECRETKEYBYTES bytes). Returns NULL if out of memory.
+eht_key* eht_expand_key(const unsigned char* sk);
+void eht_free_key(eht_key* key);
+
+// Signs COUNT messages of MLEN bytes with the expanded key. sm gets COUNT signed
+// messages of MLEN + eht_param_sig_bytes() bytes each, the same bytes that
+// crypto_sign returns. Returns 0, or -2 if out of memory.
+int  eht_sign_batch(const eht_key* key, const unsigned char* m, size_t mlen, size_t count, unsigned char* sm);
+
+#endif
@@ -0,0 +1,134 @@
+// Minimal reader and writer for numpy's .npy format, so that the C tools can
+// share files with morph.py and descent.py without going through Python.
+// https://numpy.org/doc/stable/reference/generated/numpy.lib.format.html
+
+#include "npy.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char NPY_MAGIC[] = "\x93NUMPY";
+
+// Returns a pointer to the value of KEY in the header dictionary, or NULL.
+static const char* npy_find_key(const char* header, const char* key) {
+  const char* p = strstr(header, key);
+  if (p == NULL) {
+    return NULL;
+  }
+  p = strchr(p + strlen(key), ':');
+  if (p == NULL) {
+    return NULL;
+  }
+  p++;
+  while (*p == ' ') {
+    p++;
+  }
+  return p;
+}
+
+int npy_map(const char* fname, npy_array* a) {
+  memset(a, 0, sizeof(*a));
+
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < 10) {
+    close(fd);
+    return -1;
+  }
+  void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return -1;
+  }
+  a->map = map;
+  a->maplen = st.st_size;
+
+  const unsigned char* bytes = map;
+  if (memcmp(bytes, NPY_MAGIC, 6) != 0) {
+    goto fail;
+  }
+
+  // Version 1.0 has a 2-byte header length, versions 2.0 and 3.0 a 4-byte one
+  size_t hstart, hlen;
+  if (bytes[6] == 1) {
+    hstart = 10;
+    hlen = bytes[8] | (bytes[9] << 8);
+  } else {
+    hstart = 12;
+    hlen = bytes[8] | (bytes[9] << 8) | ((size_t)bytes[10] << 16) | ((size_t)bytes[11] << 24);
+  }
+  if (hstart + hlen > a->maplen) {
+    goto fail;
+  }
+
+  char* header = calloc(hlen + 1, 1);
+  memcpy(header, bytes + hstart, hlen);
+
+  const char* descr = npy_find_key(header, "'descr'");
+  const char* order = npy_find_key(header, "'fortran_order'");
+  const char* shape = npy_find_key(header, "'shape'");
+  if (descr == NULL || order == NULL || shape == NULL || *descr != '\'' || strncmp(order, "False", 5) != 0) {
+    free(header);
+    goto fail;
+  }
+  sscanf(descr + 1, "%7[^']", a->descr);
+  a->itemsize = atoi(a->descr + 2);
+
+  long s0 = 0, s1 = 1;
+  int n = sscanf(shape, "(%ld, %ld)", &s0, &s1);
+  free(header);
+  if (n < 1 || a->itemsize == 0) {
+    goto fail;
+  }
+  a->ndim = n;
+  a->shape[0] = s0;
+  a->shape[1] = s1;
+
+  a->data = bytes + hstart + hlen;
+  if (hstart + hlen + s0 * s1 * a->itemsize > a->maplen) {
+    goto fail;
+  }
+  return 0;
+
+ fail:
+  npy_unmap(a);
+  return -1;
+}
+
+void npy_unmap(npy_array* a) {
+  if (a->map != NULL) {
+    munmap(a->map, a->maplen);
+  }
+  memset(a, 0, sizeof(*a));
+}
+
+int npy_write_header(FILE* fp, const char* descr, int ndim, const long* shape) {
+  char dict[128];
+  if (ndim == 1) {
+    snprintf(dict, sizeof(dict), "{'descr': '%s', 'fortran_order': False, 'shape': (%ld,), }", descr, shape[0]);
+  } else {
+    snprintf(dict, sizeof(dict), "{'descr': '%s', 'fortran_order': False, 'shape': (%ld, %ld), }", descr, shape[0], shape[1]);
+  }
+
+  // The header is padded with spaces and a newline so that the data is 64-byte aligned
+  size_t len = strlen(dict);
+  size_t hlen = ((10 + len + 1 + 63) / 64) * 64 - 10;
+  unsigned char prefix[10] = { 0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0, hlen & 0xff, hlen >> 8 };
+
+  if (fwrite(prefix, 1, 10, fp) != 10 || fwrite(dict, 1, len, fp) != len) {
+    return -1;
+  }
+  for (size_t i = len; i < hlen - 1; i++) {
+    fputc(' ', fp);
+  }
+  fputc('\n', fp);
+  return 0;
+}
@@ -0,0 +1,23 @@
+#ifndef npy_h
+#define npy_h
+
+#include <stddef.h>
+#include <stdio.h>
+
+// A (read-only, memory-mapped) array stored in numpy's .npy format.
+// Only C-ordered arrays with at most two dimensions are supported.
+typedef struct {
+  char descr[8];        // dtype, e.g. "<f8"
+  int ndim;
+  long shape[2];        // shape[1] is 1 for one-dimensional arrays
+  size_t itemsize;
+  const void* data;
+  void* map;
+  size_t maplen;
+} npy_array;
+
+int  npy_map(const char* fname, npy_array* a);
+void npy_unmap(npy_array* a);
+int  npy_write_header(FILE* fp, const char* descr, int ndim, const long* shape);
+
+#endif
@@ -0,0 +1,337 @@
+#define _GNU_SOURCE
+
+// Signs random messages, turns the signatures into C*z and accumulates the statistics
+// that morph.py needs, in one process: stages 01 to 03 without the intermediate files.
+//
+// The stages run concurrently and are connected by bounded lock-free rings (ring.h):
+//
+//   signer 0 --ring--+
+//   signer 1 --ring--+--> C*z --ring--> filter + moments (--> PREFIX.cz.npy, PREFIX.stats.npy)
+//   ...      --ring--+
+//
+// Signer t signs messages t, t + T, t + 2T, ... (the same messages as eht_siggen SK NSIGS
+// MSGSEED), and the C*z stage takes them round robin, so the rows come out in message order.
+// A full ring makes its producer wait, so the memory in flight is bounded and the whole
+// pipeline runs at the speed of its slowest stage.
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "parameters.h"
+#include "api.h"
+#include "rng.h"
+
+#include "common.h"
+#include "libeht.h"
+#include "npy.h"
+#include "ring.h"
+
+// Length of the random messages, as in eht_siggen
+#define MLEN 33
+#define SMLEN (MLEN + CRYPTO_BYTES)
+
+// Rows of C*z with a centered coefficient beyond this are dropped, as in loadsigs in
+// morph.py: a coefficient of C*z can be up to 27, which wraps around mod Q beyond 23.
+#define WRAP_BOUND 19
+
+// The moments are summed in int32 for this many rows (each product of two kept
+// coefficients is at most WRAP_BOUND^2), then added to the int64 totals
+#define FLUSH_ROWS (1L << 22)
+
+// Fails to compile if FLUSH_ROWS products could overflow the int32 partial sums
+typedef char flush_rows_fit_int32[(FLUSH_ROWS * WRAP_BOUND * WRAP_BOUND <= INT32_MAX) ? 1 : -1];
+
+typedef struct {
+  eht_key* key;
+  const uint8_t* A;
+  unsigned int msgseed;
+  long nsigs;
+  int nsigners;
+  ring* sig_rings;              // one per signer
+  ring cz_ring;
+  FILE* dataset;                // NULL if the rows are not kept
+  int64_t* moments;             // (M+1) x (M+1), see accumulate
+  long rows;
+  long kept;
+} pipeline;
+
+typedef struct {
+  pipeline* p;
+  int index;
+} signer_args;
+
+static void* signer(void* arg) {
+  signer_args* a = arg;
+  pipeline* p = a->p;
+  ring* out = &p->sig_rings[a->index];
+  unsigned char entropy_input[48];
+  unsigned char msg[MLEN];
+
+  for (long i = a->index; i < p->nsigs; i += p->nsigners) {
+    // Same message as eht_siggen; the DRBG state is per thread
+    ((unsigned int*)entropy_input)[0] = p->msgseed;
+    for (unsigned int j = 1; j < sizeof(entropy_input) / sizeof(unsigned int); j++) {
+      ((unsigned int*)entropy_input)[j] = i;
+    }
+    randombytes_init(entropy_input, NULL, 256);
+    randombytes(msg, MLEN);
+
+    if (eht_sign_batch(p->key, msg, MLEN, 1, ring_reserve(out)) != 0) {
+      fprintf(stderr, "Memory error.\n");
+      exit(-1);
+    }
+    ring_push(out);
+  }
+  ring_close(out);
+  return NULL;
+}
+
+static void* cz_stage(void* arg) {
+  pipeline* p = arg;
+  for (long i = 0; i < p->nsigs; i++) {
+    ring* in = &p->sig_rings[i % p->nsigners];
+    unsigned char* sm = ring_peek(in);
+    eht_cz_batch(p->A, sm, SMLEN, 1, ring_reserve(&p->cz_ring));
+    ring_push(&p->cz_ring);
+    ring_pop(in);
+  }
+  ring_close(&p->cz_ring);
+  return NULL;
+}
+
+static void flush_moments(int64_t* moments, int32_t* partial) {
+  for (int i = 0; i < (M + 1) * (M + 1); i++) {
+    moments[i] += partial[i];
+    partial[i] = 0;
+  }
+}
+
+// Centers the rows of C*z around 0, drops those that may have wrapped around, writes the
+// others to the dataset and adds the upper triangle of (1, v)^T (1, v) to the moments for
+// every row v that is kept. The moments are then the number of rows kept (at [0][0]),
+// their sum (first row) and the sums of all products of two coefficients (the rest).
+static int accumulate(pipeline* p) {
+  int32_t* partial = calloc((M + 1) * (M + 1), sizeof(int32_t));
+  if (partial == NULL) {
+    return -1;
+  }
+  int8_t v[M + 1];
+  v[0] = 1;
+  long pending = 0;
+
+  uint8_t* e;
+  while ((e = ring_peek(&p->cz_ring)) != NULL) {
+    int wrapped = 0;
+    for (int j = 0; j < M; j++) {
+      int c = (e[j] > Q / 2) ? e[j] - Q : e[j];
+      wrapped |= (c > WRAP_BOUND || c < -WRAP_BOUND);
+      v[j + 1] = c;
+    }
+    ring_pop(&p->cz_ring);
+    p->rows++;
+    if (wrapped) {
+      continue;
+    }
+    p->kept++;
+
+    if (p->dataset != NULL && fwrite(v + 1, 1, M, p->dataset) != M) {
+      free(partial);
+      return -1;
+    }
+    for (int i = 0; i <= M; i++) {
+      if (v[i] == 0) {
+        continue;
+      }
+      int32_t* row = partial + i * (M + 1);
+      for (int j = i; j <= M; j++) {
+        row[j] += v[i] * v[j];
+      }
+    }
+    if (++pending == FLUSH_ROWS) {
+      flush_moments(p->moments, partial);
+      pending = 0;
+    }
+  }
+  flush_moments(p->moments, partial);
+  free(partial);
+
+  for (int i = 0; i <= M; i++) {
+    for (int j = 0; j < i; j++) {
+      p->moments[i * (M + 1) + j] = p->moments[j * (M + 1) + i];
+    }
+  }
+  return 0;
+}
+
+static int write_stats(const char* fname, const int64_t* moments) {
+  FILE* fp = fopen(fname, "w");
+  long shape[2] = { M + 1, M + 1 };
+  if (fp == NULL || npy_write_header(fp, "<i8", 2, shape) != 0
+      || fwrite(moments, sizeof(int64_t), (M + 1) * (M + 1), fp) != (M + 1) * (M + 1)) {
+    return -1;
+  }
+  return fclose(fp);
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Usage: %s [-t SIGNERS] [-r SLOTS] [-s MSGSEED] [-o PREFIX [-S]] SECRET.sk PUBLIC.pk NSIGS\n", argv0);
+  fprintf(stderr, "  Signs NSIGS random messages (those of eht_siggen SECRET.sk NSIGS MSGSEED) on SIGNERS\n");
+  fprintf(stderr, "  threads, computes C*z for each signature like eht_sigparse, drops the rows that may\n");
+  fprintf(stderr, "  have wrapped around mod Q like morph.py, and accumulates the moments of the others.\n");
+  fprintf(stderr, "  With -o, writes the rows (centered, int8) to PREFIX.cz.npy and the moments (int64,\n");
+  fprintf(stderr, "  (M+1) x (M+1): count, sums and sums of products) to PREFIX.stats.npy; with -S, only\n");
+  fprintf(stderr, "  the moments. SLOTS is the capacity of each ring between two stages.\n");
+}
+
+int
+main(int argc, char** argv)
+{
+  pipeline p;
+  memset(&p, 0, sizeof(p));
+  p.nsigners = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+  if (p.nsigners < 1) {
+    p.nsigners = 1;
+  }
+  long nslots = 256;
+  const char* prefix = NULL;
+  int stats_only = 0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "t:r:s:o:S")) != -1) {
+    switch (opt) {
+    case 't': p.nsigners = atoi(optarg); break;
+    case 'r': nslots = atol(optarg); break;
+    case 's': p.msgseed = strtoul(optarg, NULL, 0); break;
+    case 'o': prefix = optarg; break;
+    case 'S': stats_only = 1; break;
+    default:
+      usage(argv[0]);
+      return -1;
+    }
+  }
+  if (argc - optind != 3 || p.nsigners < 1 || nslots < 1 || (stats_only && prefix == NULL)) {
+    usage(argv[0]);
+    return -1;
+  }
+  p.nsigs = atol(argv[optind + 2]);
+
+  unsigned char* sk = read_sk(argv[optind]);
+  if (sk == NULL) {
+    fprintf(stderr, "Couldn't open <%s> for private key read\n", argv[optind]);
+    return -1;
+  }
+  unsigned char* pk = read_pk(argv[optind + 1]);
+  if (pk == NULL) {
+    fprintf(stderr, "Couldn't open <%s> for public key read\n", argv[optind + 1]);
+    return -1;
+  }
+  uint8_t* A = malloc((size_t)M * N);
+  p.moments = calloc((M + 1) * (M + 1), sizeof(int64_t));
+  // The indices of a ring are aligned to cache lines, which calloc does not guarantee
+  void* rings = NULL;
+  if (posix_memalign(&rings, __alignof__(ring), p.nsigners * sizeof(ring)) == 0) {
+    memset(rings, 0, p.nsigners * sizeof(ring));
+  }
+  p.sig_rings = rings;
+  signer_args* args = calloc(p.nsigners, sizeof(signer_args));
+  pthread_t* threads = calloc(p.nsigners, sizeof(pthread_t));
+  if (A == NULL || p.moments == NULL || p.sig_rings == NULL || args == NULL || threads == NULL
+      || (p.key = eht_expand_key(sk)) == NULL || ring_init(&p.cz_ring, nslots, M) != 0) {
+    fprintf(stderr, "Memory error.\n");
+    return -1;
+  }
+  eht_pk_to_A(pk, A);
+  p.A = A;
+  for (int t = 0; t < p.nsigners; t++) {
+    if (ring_init(&p.sig_rings[t], nslots, SMLEN) != 0) {
+      fprintf(stderr, "Memory error.\n");
+      return -1;
+    }
+  }
+
+  // The number of rows is only known at the end, so the header is written again then
+  char fname[4096];
+  long shape[2] = { p.nsigs, M };
+  long data_offset = 0;
+  if (prefix != NULL && !stats_only) {
+    snprintf(fname, sizeof(fname), "%s.cz.npy", prefix);
+    if ((p.dataset = fopen(fname, "w")) == NULL || npy_write_header(p.dataset, "|i1", 2, shape) != 0) {
+      fprintf(stderr, "Couldn't open <%s> for write\n", fname);
+      return -1;
+    }
+    data_offset = ftell(p.dataset);
+  }
+
+  fprintf(stderr, "Signing %ld messages on %d threads\n", p.nsigs, p.nsigners);
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  pthread_t cz_thread;
+  for (int t = 0; t < p.nsigners; t++) {
+    args[t].p = &p;
+    args[t].index = t;
+    pthread_create(&threads[t], NULL, signer, &args[t]);
+  }
+  pthread_create(&cz_thread, NULL, cz_stage, &p);
+  int ret = accumulate(&p);
+  pthread_join(cz_thread, NULL);
+  for (int t = 0; t < p.nsigners; t++) {
+    pthread_join(threads[t], NULL);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double elapsed = (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
+
+  if (ret != 0) {
+    fprintf(stderr, "Couldn't write <%s>\n", fname);
+    return -1;
+  }
+  if (p.dataset != NULL) {
+    shape[0] = p.kept;
+    if (fseek(p.dataset, 0, SEEK_SET) != 0 || npy_write_header(p.dataset, "|i1", 2, shape) != 0
+        || ftell(p.dataset) != data_offset || fclose(p.dataset) != 0) {
+      fprintf(stderr, "Couldn't write <%s>\n", fname);
+      return -1;
+    }
+  }
+  if (prefix != NULL) {
+    snprintf(fname, sizeof(fname), "%s.stats.npy", prefix);
+    if (write_stats(fname, p.moments) != 0) {
+      fprintf(stderr, "Couldn't write <%s>\n", fname);
+      return -1;
+    }
+  }
+
+  long sig_full_waits = 0, sig_empty_waits = 0;
+  for (int t = 0; t < p.nsigners; t++) {
+    sig_full_waits += p.sig_rings[t].full_waits;
+    sig_empty_waits += p.sig_rings[t].empty_waits;
+  }
+  fprintf(stderr, "Signed %ld messages in %.2f s (%.1f per second); kept %ld of %ld rows of C*z\n",
+          p.nsigs, elapsed, p.nsigs / elapsed, p.kept, p.rows);
+  fprintf(stderr, "Waits: signers on C*z %ld, C*z on signers %ld, C*z on statistics %ld, statistics on C*z %ld\n",
+          sig_full_waits, sig_empty_waits, p.cz_ring.full_waits, p.cz_ring.empty_waits);
+  report_metric("signatures", p.nsigs);
+  report_metric("cz_rows", p.rows);
+  report_metric("kept_rows", p.kept);
+
+  for (int t = 0; t < p.nsigners; t++) {
+    ring_free(&p.sig_rings[t]);
+  }
+  ring_free(&p.cz_ring);
+  eht_free_key(p.key);
+  free(p.sig_rings);
+  free(p.moments);
+  free(threads);
+  free(args);
+  free(A);
+  free(pk);
+  free(sk);
+  return 0;
+}
@@ -0,0 +1,35 @@
+// Prints the parameter set that the tools were built with (make LEVEL=...) as
+// JSON, for the Python scripts (see params.py):
+//   ./c_utils/eht_print_params > data/params.json
+
+#include <stdio.h>
+
+#include "api.h"
+#include "parameters.h"
+
+int
+main(void)
+{
+  printf("{\n");
+  printf("  \"name\": \"%s\",\n", CRYPTO_ALGNAME);
+  printf("  \"level\": %d,\n", EHT_LEVEL);
+  printf("  \"M\": %d,\n", M);
+  printf("  \"N\": %d,\n", N);
+  printf("  \"Q\": %d,\n", Q);
+  printf("  \"K\": %d,\n", K);
+  printf("  \"C\": %d,\n", C);
+  printf("  \"D\": %d,\n", D);
+  printf("  \"TUPPLE\": [");
+  for (int i = 0; i < K; i++) {
+    printf((i < K - 1) ? "%d, " : "%d],\n", TUPPLE[i]);
+  }
+  printf("  \"NORM1\": %d,\n", NORM1);
+  printf("  \"NORM2\": %d,\n", NORM2);
+  printf("  \"S\": %d,\n", S);
+  printf("  \"L\": %d,\n", L);
+  printf("  \"secret_key_bytes\": %d,\n", CRYPTO_SECRETKEYBYTES);
+  printf("  \"public_key_bytes\": %d,\n", CRYPTO_PUBLICKEYBYTES);
+  printf("  \"signature_bytes\": %d\n", CRYPTO_BYTES);
+  printf("}\n");
+  return 0;
+}
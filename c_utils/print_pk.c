@@ -19,6 +19,7 @@ Modified July 2023 by Keegan Ryan.
 #include "general_functions.h"
 
 #include "common.h"
+#include "ehtk.h"
 
 #define KAT_SUCCESS          0
 #define KAT_FILE_OPEN_ERROR -1
@@ -44,7 +45,7 @@ main(int argc, char** argv)
     unsigned char**     A;
 
     if (argc < 2) {
-      fprintf(stderr, "Usage: ./eht_siggen secret_key.sk\n");
+      fprintf(stderr, "Usage: ./eht_print_pk public_key.pk [OUT.ehtk]\n");
       return -1;
     }
 
@@ -65,6 +66,19 @@ main(int argc, char** argv)
     pk_to_A(pk, A);
     free(pk);
 
+    if (argc > 2) {
+      // Binary key container instead of JSON
+      const char* names[] = { "A" };
+      int rows[] = { M };
+      int cols[] = { N };
+      unsigned char** mats[] = { A };
+      if (ehtk_write(argv[2], 1, names, rows, cols, mats) != 0) {
+        fprintf(stderr, "Couldn't write <%s>\n", argv[2]);
+        return KAT_FILE_OPEN_ERROR;
+      }
+      return KAT_SUCCESS;
+    }
+
     printf("{\n");
     printf("\t\"A\": ");
     fprintMat(stdout, "A", A, M, N);
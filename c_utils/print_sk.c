@@ -19,6 +19,7 @@ Modified July 2023 by Keegan Ryan.
 #include "general_functions.h"
 
 #include "common.h"
+#include "ehtk.h"
 
 #define KAT_SUCCESS          0
 #define KAT_FILE_OPEN_ERROR -1
@@ -45,7 +46,7 @@ main(int argc, char** argv)
     unsigned int        numsigs, msgseed;
 
     if (argc < 2) {
-      fprintf(stderr, "Usage: ./eht_siggen secret_key.sk\n");
+      fprintf(stderr, "Usage: ./eht_print_sk secret_key.sk [OUT.ehtk]\n");
       return -1;
     }
 
@@ -137,6 +138,20 @@ main(int argc, char** argv)
     free_matrix(N, LM); LM = NULL;
     free_matrix(N, UM); UM = NULL;
 
+    if (argc > 2) {
+      // Binary key container instead of JSON
+      const char* names[] = { "C", "T", "B" };
+      int rows[] = { M, K*N, N };
+      int cols[] = { M+D, N, N };
+      unsigned char** mats[] = { C, T, B };
+      if (ehtk_write(argv[2], 3, names, rows, cols, mats) != 0) {
+        fprintf(stderr, "Couldn't write <%s>\n", argv[2]);
+        return KAT_FILE_OPEN_ERROR;
+      }
+      free(sk);
+      return KAT_SUCCESS;
+    }
+
     printf("{\n");
     printf("\t\"C\": ");
     fprintMat(stdout, "C", C, M, M+D);
@@ -0,0 +1,61 @@
+#define _GNU_SOURCE
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ring.h"
+
+// nslots is rounded up to a power of two. Returns 0, or -1 if out of memory.
+int ring_init(ring* r, size_t nslots, size_t slot_size) {
+  memset(r, 0, sizeof(*r));
+  size_t n = 1;
+  while (n < nslots) {
+    n <<= 1;
+  }
+  r->mask = n - 1;
+  r->slot_size = slot_size;
+  r->slots = malloc(n * slot_size);
+  return (r->slots == NULL) ? -1 : 0;
+}
+
+void ring_free(ring* r) {
+  free(r->slots);
+  r->slots = NULL;
+}
+
+// The slot for the next record, once there is room for it
+unsigned char* ring_reserve(ring* r) {
+  size_t head = r->head;
+  while (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) > r->mask) {
+    r->full_waits++;
+    sched_yield();
+  }
+  return r->slots + (head & r->mask) * r->slot_size;
+}
+
+void ring_push(ring* r) {
+  __atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+}
+
+void ring_close(ring* r) {
+  __atomic_store_n(&r->closed, 1, __ATOMIC_RELEASE);
+}
+
+// The oldest record, once there is one
+unsigned char* ring_peek(ring* r) {
+  size_t tail = r->tail;
+  while (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == tail) {
+    // Check head again after seeing closed, since the last push may come just before it
+    if (__atomic_load_n(&r->closed, __ATOMIC_ACQUIRE) && __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == tail) {
+      return NULL;
+    }
+    r->empty_waits++;
+    sched_yield();
+  }
+  return r->slots + (tail & r->mask) * r->slot_size;
+}
+
+void ring_pop(ring* r) {
+  __atomic_store_n(&r->tail, r->tail + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,35 @@
+#ifndef ring_h
+#define ring_h
+
+#include <stddef.h>
+
+// A bounded single-producer, single-consumer queue of fixed-size records, without
+// locks. The producer fills the slot returned by ring_reserve and publishes it with
+// ring_push; the consumer reads the slot returned by ring_peek and releases it with
+// ring_pop. Both wait (yielding the CPU) while the ring is full or empty, so a slow
+// consumer holds back its producer (backpressure) and the memory in flight is bounded.
+typedef struct {
+  unsigned char* slots;
+  size_t slot_size;
+  size_t mask;                  // number of slots - 1 (a power of two)
+  // Each index is written by one side only, and kept on its own cache line
+  size_t head __attribute__((aligned(64)));  // records pushed (producer)
+  size_t tail __attribute__((aligned(64)));  // records popped (consumer)
+  int closed __attribute__((aligned(64)));   // set by the producer after its last push
+  // How often each side had to wait: many full waits mean the consumer is the slower stage
+  long full_waits;
+  long empty_waits;
+} ring;
+
+int   ring_init(ring* r, size_t nslots, size_t slot_size);
+void  ring_free(ring* r);
+
+unsigned char* ring_reserve(ring* r);
+void  ring_push(ring* r);
+void  ring_close(ring* r);
+
+// Returns NULL once the ring is closed and empty
+unsigned char* ring_peek(ring* r);
+void  ring_pop(ring* r);
+
+#endif
@@ -15,48 +15,32 @@ Modified July 2023 by Keegan Ryan.
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-#include "rng.h"
 #include "parameters.h"
-#include "general_functions.h"
 #include "api.h"
 
 #include "common.h"
-
-#define	MAX_MARKER_LEN		50
+#include "libeht.h"
 
 #define KAT_SUCCESS          0
 #define KAT_FILE_OPEN_ERROR -1
 #define KAT_DATA_ERROR      -3
 #define KAT_CRYPTO_FAILURE  -4
 
-// Defined in eht_sigver.c
-void pk_to_A(const unsigned char *pk, unsigned char **A);
-void sm_to_mx(const unsigned char* sm, unsigned long long smlen, unsigned char* m, unsigned long long* mlen, unsigned char** x);
-  
 char    AlgName[] = "ehtv3l1";
 
 int
 main(int argc, char** argv)
 {
-    FILE                *fp_pk;
-    unsigned char       seed[48];
-    unsigned char       msg[3300];
-    unsigned char       entropy_input[48];
-    unsigned char       *m, *sm;
-    unsigned long long  mlen, smlen, mlen1;
-    //unsigned char       pk[CRYPTO_PUBLICKEYBYTES];
-    int                 ret_val;
+    unsigned char       *sm;
+    unsigned long long  smlen;
     unsigned char* pk;
 
     char *line = NULL;
     size_t len = 0;
     ssize_t nread;
-    
 
-    unsigned char** A;
-    unsigned char** x;
-    unsigned char** Ax;
-    unsigned char** h;
+    uint8_t* A;
+    uint8_t* e;
 
     if (argc < 2) {
       fprintf(stderr, "Usage: ./sigparse FILE.pk\n");
@@ -69,19 +53,16 @@ main(int argc, char** argv)
         return KAT_FILE_OPEN_ERROR;
     }
 
-    // Allocate memory for matrices
-    A = allocate_unsigned_char_matrix_memory(M, N);
-    x = allocate_unsigned_char_matrix_memory(N, 1);
-    Ax = allocate_unsigned_char_matrix_memory(M, 1);
-    // HASH of Message
-    h = allocate_unsigned_char_matrix_memory(M, 1);
-    
-    if(A==NULL || x==NULL || Ax==NULL || h==NULL) {
+    // Allocate memory for A and e
+    A = malloc((size_t)M * N);
+    e = malloc(M);
+
+    if(A==NULL || e==NULL) {
       fprintf(stderr, "Memory error.\n");
       return KAT_DATA_ERROR;
     }
 
-    pk_to_A(pk, A);
+    eht_pk_to_A(pk, A);
     free(pk);
 
     int count = 0;
@@ -91,33 +72,10 @@ main(int argc, char** argv)
       sm = (unsigned char *)calloc(smlen, sizeof(unsigned char));
       ParseHex(line, sm, smlen);
 
-      m = (unsigned char *)calloc(smlen, sizeof(unsigned char));
-      /*
-      if ( (ret_val = crypto_sign_open(m, &mlen1, sm, smlen, pk)) != 0) {
-	// Skip lines that don't validate
-	free(sm);
-	free(m);
-	continue;
-	//fprintf(stderr, "crypto_sign_open returned <%d>\n", ret_val);
-	//return KAT_CRYPTO_FAILURE;
-	}*/
-
-      sm_to_mx(sm, smlen, m, &mlen, x);
-
-      // Get h
-      hash_of_message(m, mlen, h);
-	
-      // Get Ax = A*x
-      matrix_multiply(M, N, 1, A, x, Ax); // A*x
-
-      // Get e = h - A*x = Cz
-      for (unsigned int i = 0; i < M; i++) {
-	unsigned char e = s_mod_q(h[i][0] - Ax[i][0]);
-	// Output single byte representing e[i] mod Q
-	fwrite(&e, 1, 1, stdout);
-      }
-      
-      free(m);
+      // Get e = h - A*x = Cz, and output one byte per entry of e, mod Q
+      eht_cz_batch(A, sm, smlen, 1, e);
+      fwrite(e, 1, M, stdout);
+
       free(sm);
 
       count += 1;
@@ -126,14 +84,11 @@ main(int argc, char** argv)
       }
     }
 
-    free(line);
+    report_metric("cz_rows", count);
 
-    // Free h and Ax as we are done
-    free_matrix(M, h); h = NULL;
-    free_matrix(M, Ax); Ax = NULL;
-    // Free A and x
-    free_matrix(M, A); A = NULL;
-    free_matrix(N, x); x = NULL;
+    free(line);
+    free(A);
+    free(e);
 
     return 0;
 }
@@ -0,0 +1,46 @@
+// Checks that the sparse (Wiedemann) and dense characteristic polynomials of C1
+// agree with the reference algorithm. Built from the reference sources with
+// -DEHT_CHECK_CHARPOLY, so that every C1 that generate_C_sk draws (the singular
+// ones included) goes through all three algorithms, which abort on a mismatch.
+// Run with "make check".
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "api.h"
+#include "parameters.h"
+#include "general_functions.h"
+#include "rng.h"
+
+#define SEEDS 4
+
+// Defined in eht_keygen.c
+int generate_C_sk(unsigned char** C, unsigned char** H, unsigned char** CP, unsigned char* sk);
+
+int main(void) {
+  unsigned char** C = allocate_unsigned_char_matrix_memory(M, M+D);
+  unsigned char** H = allocate_unsigned_char_matrix_memory(M, M);
+  unsigned char** CP = allocate_unsigned_char_matrix_memory(M+1, M+1);
+  unsigned char* sk = malloc(CRYPTO_SECRETKEYBYTES);
+  if (C == NULL || H == NULL || CP == NULL || sk == NULL) {
+    fprintf(stderr, "Memory error.\n");
+    return 1;
+  }
+
+  for (int seed = 0; seed < SEEDS; seed++) {
+    unsigned char entropy[48] = { 0 };
+    entropy[0] = seed;
+    randombytes_init(entropy, NULL, 256);
+    if (generate_C_sk(C, H, CP, sk) != 0) {
+      fprintf(stderr, "Memory error.\n");
+      return 1;
+    }
+  }
+  printf("charpoly: the sparse and dense algorithms agree with the reference on %d seeds\n", SEEDS);
+
+  free_matrix(M, C);
+  free_matrix(M, H);
+  free_matrix(M+1, CP);
+  free(sk);
+  return 0;
+}
@@ -21,6 +21,7 @@ Modified July 2023 by Keegan Ryan.
 #include "api.h"
 
 #include "common.h"
+#include "libeht.h"
 
 #define	MAX_MARKER_LEN		50
 
@@ -67,9 +68,19 @@ main(int argc, char** argv)
       sm = realloc(sm, smlen + batch_len);
     }
     
-    unsigned char* m = (unsigned char *)calloc(smlen, sizeof(unsigned char));
-    unsigned long long mlen;
-    if ( (ret_val = crypto_sign_open(m, &mlen, sm, smlen, pk)) != 0) {
+    // Decode A and check the signature against it
+    uint8_t* A = malloc((size_t)M * N);
+    if (A == NULL) {
+      fprintf(stderr, "Memory error.\n");
+      return KAT_DATA_ERROR;
+    }
+    eht_pk_to_A(pk, A);
+    ret_val = eht_verify_A(A, sm, smlen);
+    free(A);
+    free(pk);
+    free(sm);
+
+    if (ret_val != 0) {
       fprintf(stderr, "Verification failed.\n");
       return -1;
     } else {
@@ -0,0 +1,162 @@
+import argparse
+import asyncio
+import os
+import sys
+import time
+
+from params import N, K
+
+"""
+Hands out descent runs to c_utils/eht_descent workers on any number of machines
+(eht_descent -c HOST:PORT), collects the vectors they recover and stops all of them
+as soon as enough distinct vectors have been found.
+
+Protocol: one message per line, in plain text. Vectors are written as "[a, b, ...]",
+sign-normalized as in descent_loop.
+
+    worker -> coordinator
+        HELLO <name> <threads>      first message
+        MORE                        asks for the next batch of runs
+        VEC <run> [...]             a vector the worker had not seen yet
+    coordinator -> worker
+        SEED <seed>                 reply to HELLO; every worker uses the same seed,
+                                    so a run index fully determines the starting point
+        SEEDS <start> <count>       reply to MORE: do runs start, ..., start + count - 1
+        NOMORE                      reply to MORE once all runs have been handed out: finish
+                                    the runs in progress, report their vectors and hang up
+        KNOWN [...]                 a vector found by someone else, no need to report it
+        STOP                        enough vectors were found: abandon all runs and exit
+
+New workers can join at any time and first get all vectors found so far.
+"""
+
+def format_vector(v):
+	return "[" + ", ".join("%d" % vi for vi in v) + "]"
+
+def parse_vector(s):
+	s = s.strip()
+	if not (s.startswith("[") and s.endswith("]")):
+		raise ValueError("malformed vector " + s)
+	return tuple(int(t) for t in s[1:-1].split(","))
+
+class Coordinator:
+	def __init__(self, outfilename, seed, runs, target, batch, known=()):
+		self.seed = seed
+		self.runs = runs
+		self.target = target
+		self.batch = batch
+		self.next_run = 0
+		self.found = set(known)
+		self.workers = {}
+		self.start = time.time()
+		self.done = asyncio.Event()
+		self.out = open(outfilename, "a")
+		if len(self.found) >= self.target:
+			self.done.set()
+
+	def log(self, *args):
+		print(f"[{time.time() - self.start:8.1f}s]", *args, file=sys.stderr)
+
+	def send(self, writer, line):
+		writer.write((line + "\n").encode())
+
+	def broadcast(self, line, skip=None):
+		for writer in self.workers:
+			if writer is not skip:
+				self.send(writer, line)
+
+	def stop(self, reason):
+		if not self.done.is_set():
+			self.log(f"stopping: {reason}")
+			self.broadcast("STOP")
+			self.done.set()
+
+	def add_vector(self, v, writer):
+		if v in self.found:
+			return
+		self.found.add(v)
+		self.out.write(format_vector(v) + "\n")
+		self.out.flush()
+		self.broadcast("KNOWN " + format_vector(v), skip=writer)
+		if len(self.found) >= self.target:
+			self.stop(f"found {len(self.found)} distinct vectors")
+
+	async def handle(self, reader, writer):
+		name = None
+		try:
+			hello = (await reader.readline()).decode().split()
+			if len(hello) < 2 or hello[0] != "HELLO":
+				return
+			name = hello[1]
+			self.workers[writer] = name
+			self.log(f"{name} joined with {hello[2] if len(hello) > 2 else '?'} threads ({len(self.workers)} workers)")
+			self.send(writer, f"SEED {self.seed}")
+			for v in self.found:
+				self.send(writer, "KNOWN " + format_vector(v))
+			if self.done.is_set():
+				self.send(writer, "STOP")
+			while not self.done.is_set():
+				line = (await reader.readline()).decode()
+				if not line:
+					break
+				if line.startswith("MORE"):
+					if self.next_run >= self.runs:
+						# The runs the worker is still doing count against the budget, so let them finish
+						self.send(writer, "NOMORE")
+						continue
+					count = min(self.batch, self.runs - self.next_run)
+					self.send(writer, f"SEEDS {self.next_run} {count}")
+					self.next_run += count
+				elif line.startswith("VEC "):
+					_, run, v = line.split(" ", 2)
+					v = parse_vector(v)
+					fresh = v not in self.found
+					self.add_vector(v, writer)
+					self.log(f"run {run} on {name}: {'new' if fresh else 'duplicate'} vector ({len(self.found)} distinct, {self.next_run} runs handed out)")
+				else:
+					self.log(f"ignoring unexpected message from {name}: {line.strip()}")
+				await writer.drain()
+			await writer.drain()
+		except (ConnectionError, ValueError) as e:
+			self.log(f"dropping {name}: {e}")
+		finally:
+			if writer in self.workers:
+				del self.workers[writer]
+				self.log(f"{name} left ({len(self.workers)} workers)")
+				if not self.workers and self.next_run >= self.runs:
+					self.stop(f"all {self.runs} runs are done")
+			writer.close()
+
+	async def serve(self, address):
+		if address.startswith("unix:"):
+			server = await asyncio.start_unix_server(self.handle, path=address[5:])
+		else:
+			host, port = address.rsplit(":", 1)
+			server = await asyncio.start_server(self.handle, host or None, int(port))
+		self.log(f"listening on {address}; {len(self.found)} vectors known, target {self.target}, at most {self.runs} runs")
+		async with server:
+			await self.done.wait()
+			# Give the workers a moment to read STOP before the connections go away
+			await asyncio.sleep(1)
+		self.out.close()
+		self.log(f"done: {len(self.found)} distinct vectors after {self.next_run} runs were handed out")
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser(description="Distribute descent runs over eht_descent workers and collect the recovered vectors.")
+	parser.add_argument("address", help="HOST:PORT or unix:PATH to listen on")
+	parser.add_argument("outfilename", help="where to write the distinct recovered vectors, one per line (appended to)")
+	parser.add_argument("--runs", type=int, default=6600, help="stop after this many runs in total")
+	parser.add_argument("--target", type=int, default=N * K, help="stop once this many distinct vectors have been found")
+	parser.add_argument("--batch", type=int, default=16, help="runs handed out per request")
+	parser.add_argument("--seed", type=int, default=int.from_bytes(os.urandom(4), "little"), help="seed shared by all workers")
+	parser.add_argument("--resume", action="store_true", help="treat the vectors already in outfilename as found")
+	args = parser.parse_args()
+
+	known = []
+	if args.resume and os.path.exists(args.outfilename):
+		with open(args.outfilename) as f:
+			known = [parse_vector(line) for line in f if line.strip()]
+	elif os.path.exists(args.outfilename):
+		open(args.outfilename, "w").close()
+	coordinator = Coordinator(args.outfilename, args.seed, args.runs, args.target, args.batch, known)
+	asyncio.run(coordinator.serve(args.address))
@@ -1,5 +1,7 @@
 from sage.all import *
 import numpy as np
+import metrics
+from morph import as_float64
 
 """
 Implements the gradient descent part of the SolveHZP algorithm from
@@ -7,47 +9,203 @@ Implements the gradient descent part of the SolveHZP algorithm from
 https://www.iacr.org/archive/asiacrypt2012/76580428/76580428.pdf
 """
 def loadstate(filename):
+	# vecs may be stored as float64, float32 or bfloat16 (uint16), see morph.STORAGE_DTYPES
 	Li = matrix(RDF, np.load(filename + ".Li.npy", allow_pickle=False))
 	vecs = np.lib.format.open_memmap(filename + ".vecs.npy", mode='r')
 	return Li, vecs
 
-# Calculate 4th moment and gradient of 4th moment
-def mom4_and_grmom4(z, vecs):
+# Calculate 2nd moment, 4th moment and gradient of 4th moment (mom2 is needed by the fixed-point update)
+def mom2_mom4_and_grmom4(z, vecs):
 	assert isinstance(vecs, np.ndarray)
 	z = np.asarray(z, dtype=np.float64)
 	tmp = vecs @ z
-	mom4 = np.mean(tmp**4)
-	grmom4 = ((4 * tmp**3) @ vecs) / len(vecs)
-	return float(mom4), vector(RDF, grmom4)
+	tmp2 = tmp**2
+	mom2 = np.mean(tmp2)
+	mom4 = np.mean(tmp2**2)
+	grmom4 = ((4 * tmp2 * tmp) @ vecs) / len(vecs)
+	return float(mom2), float(mom4), vector(RDF, grmom4)
 
-def _descent_helper(vecs, w_init, delta=0.7):
-	# Find a minimum of the function
-	# mom4(w) := E_{x from vecs} [ <x, w>^4 ]
-	# via gradient descent starting from w_init
-	# (Algorithm 2)
-	print("descent start")
-	w = w_init
-	m, gm = mom4_and_grmom4(w, vecs)
+class Moments:
+	"""
+	Evaluates mom2, mom4 and grad mom4 either over all of vecs, or over a random subsample of it.
+
+	vecs is split into chunks of consecutive rows, and the chunks are shuffled once up front.
+	Vectors stored with less precision than float64 are converted one chunk at a time.
+	A subsample of k chunks is always the first k chunks in that order, so growing the
+	subsample only touches new chunks and the chunks used early on stay in the page cache.
+	Also counts how much work was done, in evaluations and in rows read.
+	"""
+	def __init__(self, vecs, chunksize=4096):
+		self.vecs = vecs
+		self.chunksize = chunksize
+		self.nchunks = (len(vecs) + chunksize - 1) // chunksize
+		self.order = np.random.permutation(self.nchunks)
+		self.k = self.nchunks
+		self.evals = 0
+		self.rows = 0
+
+	def full(self):
+		return self.k >= self.nchunks
+
+	def __call__(self, z):
+		self.evals += 1
+		if self.full() and self.vecs.dtype == np.float64:
+			self.rows += len(self.vecs)
+			return mom2_mom4_and_grmom4(z, self.vecs)
+		z = np.asarray(z, dtype=np.float64)
+		n, s2, s4 = 0, 0., 0.
+		g = np.zeros(self.vecs.shape[1])
+		for c in self.order[:self.k]:
+			chunk = as_float64(self.vecs[c*self.chunksize:(c+1)*self.chunksize])
+			tmp = chunk @ z
+			tmp2 = tmp**2
+			s2 += tmp2.sum()
+			s4 += (tmp2**2).sum()
+			g += (tmp2 * tmp) @ chunk
+			n += len(chunk)
+		self.rows += n
+		return s2 / n, s4 / n, vector(RDF, 4 * g / n)
+
+# Update rules.
+# Each one is a generator that takes a Moments object, a starting point and a step size,
+# and yields (w, mom4(w), grad mom4(w), converged) after every iteration.
+
+def _descent_gradient(moments, w, delta):
+	# Plain gradient descent with a fixed step size (Algorithm 2)
+	_, m, gm = moments(w)
 	while True:
 		print("descending", m)
 		wnew = w - delta * gm
 		wnew = wnew / wnew.norm()
-		mnew, gm = mom4_and_grmom4(wnew, vecs)
+		_, mnew, gmnew = moments(wnew)
 		#if mnew >= m:
 		if m - mnew < .00001: # at some point we say "close enough"
-			print("descent finished")
-			return w, m
-		w,m = wnew,mnew
+			yield w, m, gm, True
+			return
+		w, m, gm = wnew, mnew, gmnew
+		yield w, m, gm, False
+
+def _descent_fixedpoint(moments, w, delta, tol=1e-8):
+	# FastICA-style fixed-point iteration for the kurtosis
+	#     w <- E[x <x,w>^3] - 3 E[<x,w>^2]^2 w
+	# Every column of C (after morphing) is a fixed point, and for our
+	# sub-Gaussian distribution they are exactly the minima of mom4.
+	# Convergence is cubic, so this needs far fewer passes than plain descent.
+	# delta is unused; it is only here so that all update rules share a signature.
+	m2, m, gm = moments(w)
+	while True:
+		print("descending", m)
+		wnew = gm / 4 - 3 * m2**2 * w
+		wnew = wnew / wnew.norm()
+		# The fixed point is only defined up to sign
+		if wnew * w < 0:
+			wnew = -wnew
+		m2, m, gm = moments(wnew)
+		converged = 1 - wnew * w < tol
+		w = wnew
+		yield w, m, gm, converged
+		if converged:
+			return
+
+def _descent_linesearch(moments, w, delta, c=1e-4, minstep=1e-6):
+	# Gradient descent with a backtracking (Armijo) line search.
+	# Starts every iteration with twice the last accepted step size, so long
+	# flat stretches are covered in a few passes.
+	_, m, gm = moments(w)
+	step = delta
+	while True:
+		print("descending", m)
+		# Only the component of the gradient tangent to the sphere matters
+		gt = gm - (gm * w) * w
+		while True:
+			wnew = w - step * gt
+			wnew = wnew / wnew.norm()
+			_, mnew, gmnew = moments(wnew)
+			if mnew <= m - c * step * (gt * gt) or step < minstep:
+				break
+			step /= 2
+		if m - mnew < .00001: # at some point we say "close enough"
+			yield w, m, gm, True
+			return
+		w, m, gm = wnew, mnew, gmnew
+		step *= 2
+		yield w, m, gm, False
+
+UPDATE_RULES = {
+	"gradient": _descent_gradient,
+	"fixedpoint": _descent_fixedpoint,
+	"linesearch": _descent_linesearch,
+}
+
+def _descent_helper(vecs, w_init, delta=0.7, update="gradient", maxevals=10000, moments=None, subsample=None):
+	# Find a minimum of the function
+	# mom4(w) := E_{x from vecs} [ <x, w>^4 ]
+	# starting from w_init, using one of UPDATE_RULES.
+	#
+	# If subsample = (start, grow, agree) is given, the descent starts on the first
+	# `start` chunks of vecs only. Whenever two successive gradients agree (cosine
+	# similarity above `agree`), mom4 stops decreasing, or the update rule converges
+	# on the current subsample, the subsample grows by a factor `grow`. Only the last iterations and the final
+	# convergence test run on the full data.
+	#
+	# Gives up after maxevals moment evaluations.
+	#
+	# Returns (w, mom4(w), iterations, moment evaluations, full passes over vecs). An iteration is one
+	# update step of the rule; a line search or a restart on a larger subsample takes several evaluations.
+	print("descent start")
+	rule = UPDATE_RULES[update]
+	if moments is None:
+		moments = Moments(vecs)
+	evals, rows = moments.evals, moments.rows
+	iters = 0
+	w = w_init
+	if subsample is None:
+		moments.k = moments.nchunks
+	else:
+		start, grow, agree = subsample
+		moments.k = min(start, moments.nchunks)
+	done = False
+	while not done:
+		done = True
+		prev = None
+		for w, m, gm, converged in rule(moments, w, delta):
+			iters += 1
+			if moments.evals - evals >= maxevals:
+				break
+			if moments.full():
+				if converged:
+					break
+				continue
+			agreed = prev is not None and (gm * prev) > agree * gm.norm() * prev.norm()
+			# mom4 going up means the subsample is too noisy for this update rule
+			noisy = prev is not None and m > mprev
+			prev, mprev = gm, m
+			if converged or agreed or noisy:
+				# Restart the update rule on a larger subsample,
+				# so that it never compares moments from different samples
+				moments.k = min(moments.k * grow, moments.nchunks)
+				print("growing subsample to", moments.k, "chunks")
+				done = False
+				break
+	evals = moments.evals - evals
+	passes = (moments.rows - rows) / len(vecs)
+	print(f"descent finished after {iters} iterations, {evals} moment evaluations ({passes:.2f} full passes)")
+	return w, m, iters, evals, passes
 
-def descent_loop(filename, delta=0.7, iters=1):
+def descent_loop(filename, delta=0.7, iters=1, update="gradient", subsample=None, stats=None):
+	# If stats is a list, (iterations, moment evaluations, full passes) of every run is appended to it
 	Li, vecs = loadstate(filename)
 	# Note: for descent, we want very fast mom4/gradmom4 computation (because we do it many times)
 	# So we load all the signatures into RAM instead of using a memory-mapped file.
 	n = len(vecs[0])
+	# Shared by all runs, so that all of them subsample the same (cached) chunks
+	moments = Moments(vecs)
 	for i in range(iters):
 		w = vector([gauss(0,1) for _ in range(n)])
 		w = w / w.norm()
-		r, m = _descent_helper(vecs, w, delta)
+		r, m, niters, nevals, npasses = _descent_helper(vecs, w, delta, update, moments=moments, subsample=subsample)
+		if stats is not None:
+			stats.append((niters, nevals, npasses))
 		if m < 1/3:
 			gamma = sqrt(sqrt(((1/3 - m)*15/2))) # scale
 		else:
@@ -58,27 +216,47 @@ def descent_loop(filename, delta=0.7, iters=1):
 			out = -out # makes deduplication easier
 		yield out
 
-def descent_oneshot(filename, delta=0.7):
-	return next(descent_loop(filename, delta, iters=1))
+def descent_oneshot(filename, delta=0.7, update="gradient", subsample=None):
+	return next(descent_loop(filename, delta, iters=1, update=update, subsample=subsample))
 
 if __name__ == "__main__":
-	from sys import argv
-	if len(argv) not in (3,4):
-		print(f"Usage: {argv[0]} infilename outfilename [loopcount]")
-		exit(1)
-	if len(argv) == 4:
-		iters = int(argv[3])
-		with open(argv[2], 'w') as f:
-			vs = descent_loop(argv[1], delta=0.7, iters=iters)
+	import argparse
+	import sys
+	parser = argparse.ArgumentParser(description="Run gradient descent on morphed vectors to recover columns of C.")
+	parser.add_argument("infilename", help="prefix of the .Li.npy/.vecs.npy files written by morph.py")
+	parser.add_argument("outfilename", help="where to write the recovered vectors, one per line")
+	parser.add_argument("loopcount", type=int, nargs="?", help="number of descent runs (default: a single run)")
+	parser.add_argument("--update", choices=UPDATE_RULES, default="gradient", help="update rule used by each descent run")
+	parser.add_argument("--delta", type=float, default=0.7, help="(initial) step size for gradient-based update rules")
+	parser.add_argument("--subsample", action="store_true", help="start each run on a small random subsample and grow it as the descent settles")
+	parser.add_argument("--subsample-start", type=int, default=4, help="initial subsample size, in chunks of 4096 vectors")
+	parser.add_argument("--subsample-grow", type=int, default=4, help="factor by which the subsample grows")
+	parser.add_argument("--subsample-agree", type=float, default=0.99, help="grow once successive gradients have at least this cosine similarity")
+	args = parser.parse_args()
+	subsample = (args.subsample_start, args.subsample_grow, args.subsample_agree) if args.subsample else None
+	stats = []
+	if args.loopcount is not None:
+		with open(args.outfilename, 'w') as f:
+			vs = descent_loop(args.infilename, delta=args.delta, iters=args.loopcount, update=args.update, subsample=subsample, stats=stats)
 			for v in vs:
 				if v != 0:
 					f.write("[" + ", ".join("%d" % vi for vi in v) + "]\n")
 					f.flush()
+		# stdout is usually thrown away by 04_hzp_descent.sh, so report on stderr
+		iters = sum(i for i, _, _ in stats)
+		evals = sum(e for _, e, _ in stats)
+		passes = sum(p for _, _, p in stats)
+		runs = max(len(stats), 1)
+		metrics.report("descent_runs", len(stats))
+		metrics.report("descent_iterations", iters)
+		metrics.report("descent_evaluations", evals)
+		print(f"{len(stats)} descent runs ({args.update}) took {iters} iterations, {iters/runs:.1f} per run, and {evals/runs:.1f} moment evaluations per run ({passes/runs:.2f} full passes per run)", file=sys.stderr)
 	else:
-		v = descent_oneshot(argv[1], delta=0.7)
+		v = next(descent_loop(args.infilename, delta=args.delta, iters=1, update=args.update, subsample=subsample, stats=stats))
+		print(f"Descent took {stats[0][0]} iterations, {stats[0][1]} moment evaluations ({stats[0][2]:.2f} full passes)")
 		if v == 0:
 			print("recovered vector is obviously wrong :(")
 			exit()
 		print(f"Found a vector with l1 norm {v.norm(1)}!")
-		with open(argv[2], 'w') as f:
+		with open(args.outfilename, 'w') as f:
 			f.write("[" + ", ".join("%d" % vi for vi in v) + "]\n")
@@ -0,0 +1,114 @@
+import ctypes
+import os
+
+import numpy as np
+
+"""
+Python bindings for c_utils/libeht.so (see c_utils/libeht.h), the parts of the EHTv3
+reference implementation that the attack scripts need in-process: the message hash,
+decoding of the public key, signing, extraction of C*z from signatures and signature
+verification.
+
+The batch functions take and return 2D uint8 arrays with one message, signed message
+or vector per row; contiguous uint8 arrays are passed to the library without copies.
+"""
+
+_lib = ctypes.CDLL(os.path.join(os.path.dirname(os.path.abspath(__file__)), "c_utils", "libeht.so"))
+
+_u8 = np.ctypeslib.ndpointer(dtype=np.uint8, flags="C_CONTIGUOUS")
+_bytes = ctypes.c_char_p
+_ull = ctypes.c_ulonglong
+
+_lib.eht_hash.argtypes = [_bytes, _ull, _u8]
+_lib.eht_hash.restype = None
+_lib.eht_pk_to_A.argtypes = [_bytes, _u8]
+_lib.eht_pk_to_A.restype = None
+_lib.eht_verify_A.argtypes = [_u8, _bytes, _ull]
+_size = ctypes.c_size_t
+_lib.eht_hash_batch.argtypes = [_u8, _size, _size, _u8]
+_lib.eht_hash_batch.restype = None
+_lib.eht_verify_batch.argtypes = [_u8, _u8, _size, _size, _u8]
+_lib.eht_verify_batch.restype = _size
+_lib.eht_cz_batch.argtypes = [_u8, _u8, _size, _size, _u8]
+_lib.eht_cz_batch.restype = None
+_lib.eht_expand_key.argtypes = [_bytes]
+_lib.eht_expand_key.restype = ctypes.c_void_p
+_lib.eht_free_key.argtypes = [ctypes.c_void_p]
+_lib.eht_free_key.restype = None
+_lib.eht_sign_batch.argtypes = [ctypes.c_void_p, _u8, _size, _size, _u8]
+
+M = _lib.eht_param_M()
+N = _lib.eht_param_N()
+Q = _lib.eht_param_Q()
+SIG_BYTES = _lib.eht_param_sig_bytes()
+
+def _rows(X):
+    # X as a contiguous 2D uint8 array (a 1D array or bytes is one row)
+    if isinstance(X, (bytes, bytearray)):
+        X = np.frombuffer(X, dtype=np.uint8)
+    X = np.ascontiguousarray(X, dtype=np.uint8)
+    return X.reshape(1, -1) if X.ndim == 1 else X
+
+def hash_of_message(msg):
+    """ h (a length M uint8 array) for the message msg (bytes), like c_utils/eht_hash """
+    h = np.empty(M, dtype=np.uint8)
+    _lib.eht_hash(msg, len(msg), h)
+    return h
+
+def read_A(fname):
+    """ Decodes the public key in the .pk file fname into A (M x N) """
+    with open(fname, "rb") as f:
+        pk = f.read()
+    A = np.empty((M, N), dtype=np.uint8)
+    _lib.eht_pk_to_A(pk, A)
+    return A
+
+def verify(A, sm):
+    """ Whether the signed message sm (bytes) verifies under A (from read_A) """
+    return _lib.eht_verify_A(np.ascontiguousarray(A, dtype=np.uint8), sm, len(sm)) == 0
+
+def hash_batch(msgs):
+    """ Hashes (len(msgs) x M) of the rows of msgs, messages of equal length """
+    msgs = _rows(msgs)
+    h = np.empty((msgs.shape[0], M), dtype=np.uint8)
+    _lib.eht_hash_batch(msgs, msgs.shape[1], msgs.shape[0], h)
+    return h
+
+def cz_batch(A, sms):
+    """ h - A*x mod Q (len(sms) x M) for the rows of sms, signed messages of equal length, like c_utils/eht_sigparse """
+    sms = _rows(sms)
+    cz = np.empty((sms.shape[0], M), dtype=np.uint8)
+    _lib.eht_cz_batch(np.ascontiguousarray(A, dtype=np.uint8), sms, sms.shape[1], sms.shape[0], cz)
+    return cz
+
+def verify_batch(A, sms):
+    """ Boolean array: whether each row of sms (signed messages of equal length) verifies under A """
+    sms = _rows(sms)
+    ok = np.empty(sms.shape[0], dtype=np.uint8)
+    _lib.eht_verify_batch(np.ascontiguousarray(A, dtype=np.uint8), sms, sms.shape[1], sms.shape[0], ok)
+    return ok.astype(bool)
+
+class Key:
+    """ A secret key (the bytes of a .sk file) expanded once for signing many messages """
+    def __init__(self, sk):
+        self._key = _lib.eht_expand_key(sk)
+        if not self._key:
+            raise MemoryError("eht_expand_key failed")
+
+    @staticmethod
+    def read(fname):
+        with open(fname, "rb") as f:
+            return Key(f.read())
+
+    def __del__(self):
+        if getattr(self, "_key", None):
+            _lib.eht_free_key(self._key)
+            self._key = None
+
+    def sign_batch(self, msgs):
+        """ Signed messages (len(msgs) x (mlen + SIG_BYTES)) for the rows of msgs, like crypto_sign """
+        msgs = _rows(msgs)
+        sms = np.empty((msgs.shape[0], msgs.shape[1] + SIG_BYTES), dtype=np.uint8)
+        if _lib.eht_sign_batch(self._key, msgs, msgs.shape[1], msgs.shape[0], sms) != 0:
+            raise MemoryError("eht_sign_batch failed")
+        return sms
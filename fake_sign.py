@@ -1,105 +1,216 @@
 from keys import load_public, load_private
 from params import *
+import metrics
 
 import argparse
 import math
 import subprocess
 import sys
 
-from sage.all import (
-    ZZ,
-    GF, Matrix, identity_matrix, vector, copy,
-    random_matrix, random_vector, set_random_seed, randint,
-)
+import numpy as np
+try:
+    import gf47
+except OSError:
+    # c_utils/libgf47.so has not been built; it is only needed with --native
+    gf47 = None
+try:
+    import eht
+except OSError:
+    # c_utils/libeht.so has not been built; hash through c_utils/eht_hash instead
+    eht = None
 
-def get_a(C, h):
-    # Get random a such that Ca = h
-    a = vector(GF(Q), C.ncols())
+# Sage is only imported without --native (in from_private and sign): the native path
+# works on numpy arrays, c_utils/libgf47.so and lll() below alone.
 
-    a[C.nrows():] = random_vector(GF(Q), len(a) - C.nrows())
-    C1 = C[:,:C.nrows()]
-    C2 = C[:,C.nrows():]
-
-    # We have C1 a1 + C2 a2 = h
-    # a1 = C1**-1 (h - C2 a2)
-    a[:C.nrows()] = C1**-1 * (h - C2 * a[C.nrows():])
-    assert C * a == h
-    return a
-    
+def to_numpy(M):
+    # Sage matrix or vector over GF(Q) (or numpy array) -> numpy array of residues
+    if isinstance(M, np.ndarray):
+        return M.astype(np.int64) % Q
+    if hasattr(M, "nrows"):
+        return np.array([int(x) for x in M.list()], dtype=np.int64).reshape(M.nrows(), M.ncols())
+    return np.array([int(x) for x in M], dtype=np.int64)
 
 def get_y_small(a):
     # What multiple y of [1, 7] is close to a?
-    x = vector(GF(Q), [1, 7])
     a0 = int(a[0])
     for y in range(a0 - 3, a0 + 3 + 1):
-        v = y * x
-        dist = int(v[1] - a[1])
+        dist = (7 * y - int(a[1])) % Q
         if dist <= 3 or dist >= Q - 3:
             break
     return y
 
-def get_yz(T, a):
-    # What is the length of the non-triangular bit?
-    for i in range(T.ncols()):
-        col = T.ncols() - i - 1
-        if not T[:-2*(i+1),col].is_zero():
-            break
-    triangular_columns = i
-    non_tri_cols = T.ncols() - triangular_columns
-
-    # Get the nontriangular part of T
-    T_ul = T[:T.nrows()-2*triangular_columns,:non_tri_cols]
-
-    a_top = a[:T_ul.nrows()]
-    # Find y_top such that a_top = T_ul * y_top + z_top
-    # for z bounded
-    L = Matrix(ZZ, T_ul.nrows() + 1, T_ul.nrows() + 1)
-    T_ul_ech = T_ul.T.echelon_form()
-    m = T_ul_ech.nrows()
-    n = T_ul_ech.ncols()
-    L[:m,:n] = T_ul_ech
-    L[m:n,m:n] = identity_matrix(ZZ,n-m) * Q
-
-    # CVP embedding
-    cvp_embed = 9
-    L[-1,:n] = a_top
-    L[-1,-1] = cvp_embed
-
-    L = L.LLL()
-    if L[-1,-1] == -cvp_embed:
-        L[-1] *= -1
-    assert L[-1,-1] == cvp_embed
-
-    z_top = vector(GF(Q), L[-1,:n].list())
-    y_top = T_ul.solve_right(a_top - z_top)
-
-    # Get the triangular part of T
-    y = vector(GF(Q), T.ncols())
-    y[:len(y_top)] = y_top
-    z = copy(a) - T*y
-
-    for i in range(len(y) - len(y_top)):
-        ind = len(z_top) + 2 * i
-        a_sub = z[ind:ind+2]
-
-        # Get value of y that fits best
-        yi = get_y_small(a_sub)
-        z -= yi * vector(T[:,len(y_top) + i])
-        y[len(y_top) + i] = yi
-
-    # Now have candidate y, z
-    z = a - T*y
-    for zi in z.list():
-        zi = int(zi)
-        assert zi <= 3 or zi >= Q - 3
-    return y, z
+def gram_schmidt(L):
+    # Gram-Schmidt orthogonalization (without normalization) of the rows of L
+    Ls = L.astype(np.float64)
+    for i in range(len(Ls)):
+        for j in range(i):
+            Ls[i] -= (Ls[i] @ Ls[j]) / (Ls[j] @ Ls[j]) * Ls[j]
+    return Ls
+
+def lll(L, delta=0.99):
+    # Textbook LLL on the rows of the full-rank integer basis L, like lll() in
+    # c_utils/forge.c: the Gram-Schmidt data is simply recomputed after every swap.
+    L = L.copy()
+    n = len(L)
+    def orthogonalize():
+        Ls = gram_schmidt(L)
+        norm = np.einsum("ij,ij->i", Ls, Ls)
+        return L @ Ls.T / norm, norm
+    mu, norm = orthogonalize()
+    k = 1
+    while k < n:
+        for j in range(k - 1, -1, -1):
+            q = int(np.rint(mu[k, j]))
+            if q != 0:
+                L[k] -= q * L[j]
+                mu[k, :j] -= q * mu[j, :j]
+                mu[k, j] -= q
+        if norm[k] >= (delta - mu[k, k - 1]**2) * norm[k - 1]:
+            k += 1
+        else:
+            L[[k - 1, k]] = L[[k, k - 1]]
+            mu, norm = orthogonalize()
+            k = max(k - 1, 1)
+    return L
+
+class PreparedKey:
+    """
+    Everything in a partial private key that sign() needs and that does not depend on
+    the message, so that each attempt of the rejection loop is just a triangular solve
+    and a Babai rounding. Computed once with PreparedKey.from_private (with native=True,
+    from a key loaded with load_private(..., native=True), without Sage: the GF(Q)
+    linear algebra runs in c_utils/libgf47.so and LLL is lll() above), and saved
+    to/loaded from a .npz file with save/load.
+    """
+    FIELDS = ["C", "T", "B", "C1_inv", "C1_lu", "C1_perm", "tri_cols", "Y_piv", "pivots", "L", "L_gso"]
+
+    def __init__(self, **fields):
+        for name in self.FIELDS:
+            setattr(self, name, fields.get(name))
+        self.C1_factor = gf47.LU.from_factors(self.C1_lu, self.C1_perm) if self.C1_lu is not None else None
+
+    @staticmethod
+    def from_private(priv, native=False):
+        C = to_numpy(priv.C)
+        T = to_numpy(priv.T)
+        if not native:
+            from sage.all import ZZ, GF, Matrix, identity_matrix
+
+        # a1 = C1**-1 (h - C2 a2) in get_a; with native=True, C1 is LU-factored instead
+        rows = C.shape[0]
+        fields = {}
+        if native:
+            C1_factor = gf47.LU(C[:,:rows])
+            fields["C1_lu"], fields["C1_perm"] = C1_factor.LU, C1_factor.perm
+        else:
+            fields["C1_inv"] = to_numpy(priv.C[:,:rows]**-1)
+
+        # What is the length of the non-triangular bit?
+        for i in range(T.shape[1]):
+            col = T.shape[1] - i - 1
+            if np.any(T[:-2*(i+1),col]):
+                break
+        triangular_columns = i
+        non_tri_cols = T.shape[1] - triangular_columns
+
+        # Get the nontriangular part of T
+        T_ul = T[:T.shape[0]-2*triangular_columns,:non_tri_cols]
+
+        # The lattice of a_top that are close to T_ul * y_top is the q-ary lattice
+        # spanned by the rows of the echelon form of T_ul.T and Q times the unit vectors
+        # at the non-pivot columns.
+        if native:
+            T_ul_ech, pivots = gf47.rref(T_ul.T)
+        else:
+            T_ul_ech = Matrix(GF(Q), T_ul.T.tolist()).echelon_form()
+            pivots = T_ul_ech.pivots()
+            T_ul_ech = to_numpy(T_ul_ech)
+        m = len(pivots)
+        n = T_ul_ech.shape[1]
+        L = np.zeros((n, n), dtype=np.int64)
+        L[:m,:] = T_ul_ech[:m,:]
+        for k, j in enumerate(sorted(set(range(n)) - set(pivots))):
+            L[m + k, j] = Q
+        if native:
+            L = lll(L)
+        else:
+            L = Matrix(ZZ, L.tolist()).LLL()
+            L = np.array([int(x) for x in L.list()], dtype=np.int64).reshape(n, n)
+
+        # A vector v in the column span of T_ul is determined by its entries at the
+        # pivots, and T_ul * y_top = v for y_top = Y_piv * v[pivots].
+        if native:
+            Y_piv = gf47.solve_right(T_ul[list(pivots),:], np.eye(m, dtype=np.int64))
+        else:
+            Y_piv = Matrix(GF(Q), T_ul[list(pivots),:].tolist()).solve_right(identity_matrix(GF(Q), m))
+
+        fields.update(
+            C=C, T=T, B=to_numpy(priv.B),
+            tri_cols=np.array(triangular_columns), Y_piv=to_numpy(Y_piv),
+            pivots=np.array(pivots, dtype=np.int64), L=L, L_gso=gram_schmidt(L),
+        )
+        return PreparedKey(**fields)
+
+    def save(self, fname):
+        np.savez(fname, **{name: getattr(self, name) for name in self.FIELDS if getattr(self, name) is not None})
+
+    @staticmethod
+    def load(fname):
+        with np.load(fname) as data:
+            return PreparedKey(**{name: data[name] for name in data.files})
+
+    def get_a(self, h, a2):
+        # a such that C a = h, with a[C.nrows():] = a2
+        # We have C1 a1 + C2 a2 = h
+        # a1 = C1**-1 (h - C2 a2)
+        rows = self.C.shape[0]
+        rhs = (h - self.C[:,rows:] @ a2) % Q
+        if self.C1_factor is not None:
+            a1 = self.C1_factor.solve(rhs).astype(np.int64)
+        else:
+            a1 = self.C1_inv @ rhs % Q
+        return np.concatenate([a1, a2])
+
+    def babai(self, t):
+        # Babai's nearest plane on the reduced basis L: returns t - v for a lattice vector v close to t
+        r = t.copy()
+        for i in range(len(self.L) - 1, -1, -1):
+            c = np.rint((r @ self.L_gso[i]) / (self.L_gso[i] @ self.L_gso[i]))
+            r -= int(c) * self.L[i]
+        return r
+
+    def get_yz(self, a):
+        # y, z such that a = T y + z and z is bounded, or None if Babai's rounding
+        # did not find a small enough z
+        n = len(self.L)
+        a_top = a[:n]
+        # Find y_top such that a_top = T_ul * y_top + z_top for z_top bounded
+        z_top = self.babai(a_top)
+        v = (a_top - z_top) % Q
+        y_top = self.Y_piv @ v[self.pivots] % Q
+
+        # Get the triangular part of T
+        y = np.zeros(self.T.shape[1], dtype=np.int64)
+        y[:len(y_top)] = y_top
+        z = (a - self.T @ y) % Q
+        for i in range(len(y) - len(y_top)):
+            ind = n + 2 * i
+            # Get value of y that fits best
+            yi = get_y_small(z[ind:ind+2]) % Q
+            z = (z - yi * self.T[:,len(y_top) + i]) % Q
+            y[len(y_top) + i] = yi
+
+        if np.any((z > 3) & (z < Q - 3)):
+            return None
+        return y, z
 
 def eht_hash(msg):
-    # Return h corresponding to msg.
+    # Return h corresponding to msg, as a numpy array of residues.
+    if eht is not None:
+        return eht.hash_of_message(msg).astype(np.int64)
     p = subprocess.Popen(["c_utils/eht_hash"], stdin=subprocess.PIPE, stdout=subprocess.PIPE)
     stdout, stderr = p.communicate(msg)
-    h = list(bytearray(stdout))
-    return vector(GF(Q),h)
+    return np.frombuffer(stdout, dtype=np.uint8).astype(np.int64)
 
 def encode_mx(msg, x):
     size = int(math.ceil(len(x) * math.log(Q) / math.log(256)))
@@ -116,49 +227,68 @@ def encode_mx(msg, x):
     sm = bytes(bytearray(sm)) + msg
     return sm
 
-def sign(priv, msg):
-    Zq = GF(Q)
-
-    C = priv.C
-    T = priv.T
-    B = priv.B
+def sign(key, msg, native=False):
+    # Returns (signed message, number of attempts, number of attempts where
+    # Babai's rounding was not close enough). With native=True, the random a are
+    # drawn with numpy instead of Sage.
     h = eht_hash(msg)
+    rows, cols = key.C.shape
 
-    set_random_seed(3)
+    if native:
+        rng = np.random.default_rng(3)
+        random_a2 = lambda: rng.integers(0, Q, cols - rows)
+    else:
+        from sage.all import GF, random_vector, set_random_seed
+        set_random_seed(3)
+        random_a2 = lambda: np.array([int(x) for x in random_vector(GF(Q), cols - rows)], dtype=np.int64)
+    attempts = rejected = 0
     while True:
+        attempts += 1
         # Generate a such that C * a = h
-        a = get_a(C, h)
+        a2 = random_a2()
+        a = key.get_a(h, a2)
 
         # Generate y, z such that a = Ty + z
         # and z is bounded
-        y, z = get_yz(T, a)
-
-        e = C * z
-        e_int = [
-            int(e[i]) for i in range(len(e))
-        ]
-        # At least l entries of e are at most s
-        count = sum([
-            1 if ei <= 13 or ei >= Q - 13 else 0 for ei in e_int
-        ])
-        if count >= 451:
+        yz = key.get_yz(a)
+        if yz is None:
+            rejected += 1
+            continue
+        y, z = yz
+
+        e = key.C @ z % Q
+        # At least L entries of e are at most S
+        count = np.count_nonzero((e <= S) | (e >= Q - S))
+        if count >= L:
             break
-    x = B * y
-    return encode_mx(msg, x)
+    x = key.B @ y % Q
+    return encode_mx(msg, x), attempts, rejected
 
 def main():
     parser = argparse.ArgumentParser(
         description='Run the private key recovery attack from knowledge of columns.'
     )
-    parser.add_argument('priv', type=str, help="Fake private key")
+    parser.add_argument('priv', type=str, help="Fake private key, or a prepared key (.npz) written with --save-prepared")
     parser.add_argument('msg', type=str, help="Message to sign")
+    parser.add_argument('--native', action='store_true', help="run without Sage: GF(47) linear algebra in c_utils/libgf47.so, LLL and randomness in numpy")
+    parser.add_argument('--save-prepared', type=str, help="also save the prepared key to this file (.npz)")
     args = parser.parse_args()
+    assert not args.native or gf47 is not None, "build c_utils/libgf47.so first"
 
-    priv = load_private(args.priv, real=False)
+    if args.priv.endswith(".npz"):
+        key = PreparedKey.load(args.priv)
+    else:
+        priv = load_private(args.priv, real=False, native=args.native)
+        key = PreparedKey.from_private(priv, args.native)
+    if args.save_prepared:
+        key.save(args.save_prepared)
 
     msg = args.msg.encode()
 
-    sig = sign(priv, msg)
+    sig, attempts, rejected = sign(key, msg, args.native)
+    print(f"Signed after {attempts} attempts ({rejected} with z out of bounds)", file=sys.stderr)
+    metrics.report("forged_signatures", 1)
+    metrics.report("forge_attempts", attempts)
     sys.stdout.buffer.write(sig)
 
 if __name__ == "__main__":
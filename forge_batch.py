@@ -0,0 +1,82 @@
+from fake_sign import PreparedKey, sign, gf47
+from keys import load_private
+import eht
+import metrics
+
+import argparse
+import multiprocessing
+import sys
+import time
+
+"""
+Forges signatures for many messages at once. The prepared key (see PreparedKey in
+fake_sign.py) is computed or loaded once and shared by all worker processes; messages
+are hashed and signatures verified in-process through c_utils/libeht.so (see eht.py),
+against A decoded once from the public key.
+"""
+
+# Worker process state, set up by init_worker (inherited through fork)
+_key = None
+_A = None
+_native = False
+
+def init_worker(key, A, native):
+    global _key, _A, _native
+    _key = key
+    _A = A
+    _native = native
+
+def forge(msg):
+    sm, attempts, rejected = sign(_key, msg, _native)
+    return sm, attempts, rejected, eht.verify(_A, sm)
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Forge signatures for a list of messages with a partial private key.'
+    )
+    parser.add_argument('priv', type=str, help="Fake private key, or a prepared key (.npz) written with --save-prepared")
+    parser.add_argument('pk', type=str, help="Public key (.pk) to verify the forgeries with")
+    parser.add_argument('messages', type=str, help="File with one message per line (- for stdin)")
+    parser.add_argument('out', type=str, help="Output file for the hex-encoded signatures, one per line like eht_siggen")
+    parser.add_argument('--jobs', '-j', type=int, default=multiprocessing.cpu_count(), help="number of worker processes")
+    parser.add_argument('--native', action='store_true', help="run without Sage: GF(47) linear algebra in c_utils/libgf47.so, LLL and randomness in numpy")
+    parser.add_argument('--save-prepared', type=str, help="also save the prepared key to this file (.npz)")
+    args = parser.parse_args()
+    assert not args.native or gf47 is not None, "build c_utils/libgf47.so first"
+
+    if args.priv.endswith(".npz"):
+        key = PreparedKey.load(args.priv)
+    else:
+        key = PreparedKey.from_private(load_private(args.priv, real=False, native=args.native), args.native)
+    if args.save_prepared:
+        key.save(args.save_prepared)
+    A = eht.read_A(args.pk)
+
+    f = sys.stdin if args.messages == "-" else open(args.messages)
+    msgs = [line.rstrip("\n").encode() for line in f]
+
+    start = time.time()
+    if args.jobs > 1:
+        ctx = multiprocessing.get_context("fork")
+        with ctx.Pool(args.jobs, initializer=init_worker, initargs=(key, A, args.native)) as pool:
+            results = pool.map(forge, msgs, chunksize=max(1, len(msgs) // (4 * args.jobs)))
+    else:
+        init_worker(key, A, args.native)
+        results = [forge(msg) for msg in msgs]
+    elapsed = time.time() - start
+
+    attempts = rejected = failed = 0
+    with open(args.out, "w") as g:
+        for sm, n, r, ok in results:
+            g.write(sm.hex().upper() + "\n")
+            attempts += n
+            rejected += r
+            failed += not ok
+
+    print(f"Forged {len(msgs)} signatures in {elapsed:.2f} s ({len(msgs) / elapsed:.1f} per second), {failed} failed to verify", file=sys.stderr)
+    metrics.report("forged_signatures", len(msgs))
+    metrics.report("forge_attempts", attempts)
+    print(f"{attempts} attempts, acceptance rate {len(msgs) / max(attempts, 1):.3f} ({rejected} attempts with z out of bounds)", file=sys.stderr)
+
+if __name__ == "__main__":
+    main()
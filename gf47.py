@@ -0,0 +1,132 @@
+import ctypes
+import os
+
+import numpy as np
+
+"""
+Python bindings for c_utils/libgf47.so, dense linear algebra over GF(47).
+
+Matrices are numpy arrays of residues mod 47 (any integer dtype is accepted; results
+are uint8). The functions mirror the Sage methods that partial_key_recovery.py and
+fake_sign.py use, and return the same results (e.g. kernels come with the same
+echelonized basis), so that both scripts can switch with --native.
+"""
+
+Q = 47
+
+_lib = ctypes.CDLL(os.path.join(os.path.dirname(os.path.abspath(__file__)), "c_utils", "libgf47.so"))
+
+_u8 = np.ctypeslib.ndpointer(dtype=np.uint8, flags="C_CONTIGUOUS")
+_i32 = np.ctypeslib.ndpointer(dtype=np.int32, flags="C_CONTIGUOUS")
+_int = ctypes.c_int
+
+_lib.gf47_mul.argtypes = [_u8, _u8, _u8, _int, _int, _int]
+_lib.gf47_rref.argtypes = [_u8, _int, _int, _i32]
+_lib.gf47_rank.argtypes = [_u8, _int, _int]
+_lib.gf47_right_kernel.argtypes = [_u8, _int, _int, _u8]
+_lib.gf47_solve_right.argtypes = [_u8, _int, _int, _u8, _int, _u8]
+_lib.gf47_inverse.argtypes = [_u8, _int, _u8]
+_lib.gf47_lu.argtypes = [_u8, _int, _i32]
+_lib.gf47_lu_solve.argtypes = [_u8, _i32, _int, _u8, _int]
+
+def asmatrix(A):
+    """ Returns A as a contiguous 2-dimensional uint8 array of residues mod 47 """
+    A = np.asarray(A)
+    if A.ndim == 1:
+        A = A.reshape(-1, 1)
+    if A.dtype != np.uint8 or A.max(initial=0) >= Q:
+        A = np.mod(A, Q).astype(np.uint8)
+    return np.ascontiguousarray(A)
+
+def mul(A, B):
+    A, B = asmatrix(A), asmatrix(B)
+    assert A.shape[1] == B.shape[0]
+    C = np.empty((A.shape[0], B.shape[1]), dtype=np.uint8)
+    if _lib.gf47_mul(A, B, C, A.shape[0], A.shape[1], B.shape[1]) != 0:
+        raise MemoryError
+    return C
+
+def rref(A):
+    """ Returns (reduced row echelon form of A, pivot columns) """
+    R = asmatrix(A).copy()
+    pivots = np.zeros(min(R.shape) + 1, dtype=np.int32)
+    rank = _lib.gf47_rref(R, R.shape[0], R.shape[1], pivots)
+    if rank < 0:
+        raise MemoryError
+    return R, tuple(int(p) for p in pivots[:rank])
+
+def rank(A):
+    A = asmatrix(A)
+    r = _lib.gf47_rank(A, A.shape[0], A.shape[1])
+    if r < 0:
+        raise MemoryError
+    return r
+
+def right_kernel(A):
+    """ Basis of the right kernel of A, one vector per row, in echelon form """
+    A = asmatrix(A)
+    K = np.zeros((A.shape[1], A.shape[1]), dtype=np.uint8)
+    dim = _lib.gf47_right_kernel(A, A.shape[0], A.shape[1], K)
+    if dim < 0:
+        raise MemoryError
+    return K[:dim].copy()
+
+def left_kernel(A):
+    """ Basis of the left kernel of A, one vector per row, in echelon form """
+    return right_kernel(asmatrix(A).T)
+
+def solve_right(A, B):
+    """ Returns X with A X = B (a vector if B is one). Raises ValueError if there is none. """
+    isvector = np.ndim(B) == 1
+    A, B = asmatrix(A), asmatrix(B)
+    assert A.shape[0] == B.shape[0]
+    X = np.empty((A.shape[1], B.shape[1]), dtype=np.uint8)
+    ret = _lib.gf47_solve_right(A, A.shape[0], A.shape[1], B, B.shape[1], X)
+    if ret == -2:
+        raise MemoryError
+    if ret != 0:
+        raise ValueError("matrix equation has no solutions")
+    return X.reshape(-1) if isvector else X
+
+def is_invertible(A):
+    A = asmatrix(A)
+    return A.shape[0] == A.shape[1] and rank(A) == A.shape[0]
+
+def inverse(A):
+    A = asmatrix(A)
+    assert A.shape[0] == A.shape[1]
+    X = np.empty_like(A)
+    ret = _lib.gf47_inverse(A, A.shape[0], X)
+    if ret == -2:
+        raise MemoryError
+    if ret != 0:
+        raise ZeroDivisionError("matrix must be nonsingular")
+    return X
+
+class LU:
+    """ LU decomposition of an invertible matrix, for solving many systems with it """
+    def __init__(self, A):
+        self.LU = asmatrix(A).copy()
+        n = self.LU.shape[0]
+        assert self.LU.shape[1] == n
+        self.perm = np.zeros(n, dtype=np.int32)
+        rank = _lib.gf47_lu(self.LU, n, self.perm)
+        if rank < 0:
+            raise MemoryError
+        if rank != n:
+            raise ZeroDivisionError("matrix must be nonsingular")
+
+    @staticmethod
+    def from_factors(lu, perm):
+        """ Rebuilds an LU from the LU and perm attributes of another one (e.g. after saving them) """
+        self = LU.__new__(LU)
+        self.LU = asmatrix(lu)
+        self.perm = np.ascontiguousarray(perm, dtype=np.int32)
+        return self
+
+    def solve(self, B):
+        isvector = np.ndim(B) == 1
+        X = asmatrix(B).copy()
+        if _lib.gf47_lu_solve(self.LU, self.perm, self.LU.shape[0], X, X.shape[1]) != 0:
+            raise MemoryError
+        return X.reshape(-1) if isvector else X
@@ -1,38 +1,76 @@
 import json
-from sage.all import Matrix, GF
+import struct
+
+import numpy as np
 from params import *
 
-def load_public(fname):
-    with open(fname) as f:
-        data = json.loads(f.read())
-        
-    Zq = GF(Q)
-    A = Matrix(Zq, data["A"])
-    assert A.nrows() == M
-    assert A.ncols() == N
-    return EHTPublic(A)
-
-def load_private(fname, real=True):
+# Binary key container (.ehtk), see c_utils/ehtk.h for the layout
+EHTK_MAGIC = b"EHTK"
+EHTK_VERSION = 1
+EHTK_ALIGN = 64
+EHTK_NAMELEN = 8
+
+def is_ehtk(fname):
+    with open(fname, "rb") as f:
+        return f.read(4) == EHTK_MAGIC
+
+def save_ehtk(fname, **mats):
+    # mats: name -> numpy array of residues (or anything np.asarray turns into one)
+    mats = {name: np.ascontiguousarray(np.asarray(mat) % Q, dtype=np.uint8) for name, mat in mats.items()}
+    align = lambda x: (x + EHTK_ALIGN - 1) // EHTK_ALIGN * EHTK_ALIGN
+    offset = align(12 + 24 * len(mats))
+    header = EHTK_MAGIC + struct.pack("<II", EHTK_VERSION, len(mats))
+    for name, mat in mats.items():
+        header += struct.pack("<8sIIQ", name.encode(), mat.shape[0], mat.shape[1], offset)
+        offset = align(offset + mat.size)
+    with open(fname, "wb") as f:
+        f.write(header.ljust(align(len(header)), b"\0"))
+        for mat in mats.values():
+            f.write(mat.tobytes().ljust(align(mat.size), b"\0"))
+
+def load_ehtk(fname):
+    # Returns name -> read-only uint8 array, memory-mapped from the file
+    data = np.memmap(fname, dtype=np.uint8, mode="r")
+    magic, (version, count) = bytes(data[:4]), struct.unpack("<II", data[4:12])
+    assert magic == EHTK_MAGIC and version == EHTK_VERSION, f"{fname} is not an .ehtk file"
+    mats = {}
+    for k in range(count):
+        name, rows, cols, offset = struct.unpack("<8sIIQ", data[12 + 24*k:36 + 24*k])
+        mats[name.rstrip(b"\0").decode()] = data[offset:offset + rows*cols].reshape(rows, cols)
+    return mats
+
+def load_matrices(fname):
+    # name -> numpy array, from an .ehtk file or the JSON written by eht_print_sk/pk
+    if is_ehtk(fname):
+        return load_ehtk(fname)
     with open(fname) as f:
-        data = json.loads(f.read())
+        return {name: np.array(mat, dtype=np.int64) % Q for name, mat in json.loads(f.read()).items()}
 
-    Zq = GF(Q)
-    C = Matrix(Zq, data["C"])
-    if real:
-        assert C.nrows() == M
-        assert C.ncols() == M + D
+def to_sage(mat):
+    # Sage is only imported here, so that the native paths (numpy and c_utils/libgf47.so)
+    # run without it. Much faster than building the matrix from nested lists.
+    from sage.all import Matrix, GF
+    return Matrix(GF(Q), mat.shape[0], mat.shape[1], mat.ravel().tolist())
 
-    T = Matrix(Zq, data["T"])
-    if real:
-        assert T.nrows() == M + D
-        assert T.ncols() == N
+def convert(mat, native):
+    # Sage matrix over GF(Q), or (native=True) int64 numpy array of residues
+    return np.asarray(mat, dtype=np.int64) if native else to_sage(mat)
+
+def load_public(fname, native=False):
+    data = load_matrices(fname)
+
+    assert data["A"].shape == (M, N)
+    return EHTPublic(convert(data["A"], native))
+
+def load_private(fname, real=True, native=False):
+    data = load_matrices(fname)
 
-    B = Matrix(Zq, data["B"])
     if real:
-        assert B.nrows() == N
-        assert B.ncols() == N
+        assert data["C"].shape == (M, M + D)
+        assert data["T"].shape == (M + D, N)
+        assert data["B"].shape == (N, N)
 
-    return EHTPrivate(C, T, B)
+    return EHTPrivate(convert(data["C"], native), convert(data["T"], native), convert(data["B"], native))
 
 class EHTPrivate:
     def __init__(self, C, T, B):
@@ -0,0 +1,35 @@
+import os
+import sys
+
+"""
+Counters that the stages of the attack report to run_pipeline.py. When EHT_METRICS
+is set in the environment (run_pipeline.py sets it), report() prints a line
+
+    METRIC <name> <value>
+
+on stderr; otherwise it does nothing. The C tools print the same lines through
+report_metric in c_utils/common.c. Values are counts: run_pipeline.py adds up all
+values of the same name within a stage (e.g. from parallel processes) and divides
+the sum by the wall time of the stage for a rate.
+"""
+
+PREFIX = "METRIC "
+
+def enabled():
+    return bool(os.environ.get("EHT_METRICS"))
+
+def report(name, value):
+    if enabled():
+        print(f"{PREFIX}{name} {value}", file=sys.stderr, flush=True)
+
+def parse(line):
+    # (name, value) if line is a METRIC line, None otherwise
+    if not line.startswith(PREFIX):
+        return None
+    fields = line[len(PREFIX):].split()
+    if len(fields) != 2:
+        return None
+    try:
+        return fields[0], float(fields[1])
+    except ValueError:
+        return None
@@ -1,6 +1,9 @@
 from sage.all import *
 import numpy as np
 
+from params import M, Q
+import metrics
+
 """
 Given a bunch of vectors C*z (for many unknown vectors z whose coefficients are in {-3, -2, ..., 2, 3}),
 compute a transformation L such that C*L should be approximately orthogonal. Output L and the transformed input vectors.
@@ -11,16 +14,19 @@ https://www.iacr.org/archive/asiacrypt2012/76580428/76580428.pdf
 
 def loadsigs(filename):
 	"""
-	Load C*z samples from a file produced by 02_process_signatures.sh.
-	(If x is the signature of message hash h, then these are (h - A*x) mod 47.)
+	Load C*z samples from a file produced by 02_process_signatures.sh, or from the
+	PREFIX.cz.npy file written by c_utils/eht_pipeline.
+	(If x is the signature of message hash h, then these are (h - A*x) mod Q.)
 	"""
-	# Input format: each coefficient is a uint8 (taking a value between 0 and 46). 460 bytes per sample.
+	if filename.endswith(".npy"):
+		return loadsigs_npy(filename)
+	# Input format: each coefficient is a uint8 (taking a value between 0 and Q-1). M bytes per sample.
 	sigs = np.fromfile(filename, dtype=np.int8)
 	# Here we're reading signed int8 values instead of uint8 values, but that's okay because no entry should be larger than 46.
-	nsigs = len(sigs) // 460
+	nsigs = len(sigs) // M
 	print("number of sigs:",nsigs)
-	sigs = (sigs + 23) % 47 - 23 # center around 0
-	sigs.resize((nsigs,460))
+	sigs = (sigs + Q//2) % Q - Q//2 # center around 0
+	sigs.resize((nsigs,M))
 	# We can run into issues later when computing the covariance matrix due to wraparound mod 47.
 	# Each row of C has l1 norm 9, and each z has l_inf norm <= 3.
 	# So it's possible a coefficient of Cz could be as high as 27, which mod 47 centered around 0 becomes -20.
@@ -31,17 +37,42 @@ def loadsigs(filename):
 	# We divide by 3 here so that we can pretend coefficients of z were in the range [-1,1] instead of [-3,3].
 	return sigs
 
+def loadsigs_npy(filename):
+	"""
+	Load the C*z samples written by c_utils/eht_pipeline: int8, already centered around 0
+	and without the samples that may have wrapped around (see loadsigs).
+	"""
+	sigs = np.load(filename, mmap_mode="r")
+	assert sigs.dtype == np.int8 and sigs.ndim == 2 and sigs.shape[1] == M
+	print("number of sigs:",len(sigs))
+	return sigs.astype(np.float64) / 3.
+
 def covar(vecs):
 	""" Compute the covariance matrix of the input """
 	return matrix(RDF, np.cov(vecs, rowvar=False, dtype=np.float64))
 
-def morphing(vecs):
+def covar_from_stats(filename):
+	"""
+	Compute the covariance matrix of the samples loadsigs returns from the moments of the
+	samples, as accumulated (exactly, in int64) by c_utils/eht_pipeline in PREFIX.stats.npy:
+	S[0,0] is the number n of samples, S[0,1:] their sum s and S[1:,1:] the sum P of the
+	products of their coefficients.
+	"""
+	S = np.load(filename)
+	assert S.dtype == np.int64 and S.shape == (M + 1, M + 1)
+	n = int(S[0,0])
+	s = S[0,1:]
+	# n*P - s*s^T is exact in int64; the samples were divided by 3, hence the 9
+	cov = (n * S[1:,1:] - np.outer(s, s)) / (9. * n * (n - 1))
+	return matrix(RDF, cov)
+
+def morphing(vecs, cov=None):
 	# It's morphing time!
 	# Given a bunch of C*z, return L such that L * D_(P(C)) is close to D_(P(C')) where C' is orthogonal
 	# i.e., turn a (projection of a) parallelepiped into a (projection of a) hypercube
-	# 1. Compute approximation G of C * C.T using covariance
+	# 1. Compute approximation G of C * C.T using covariance (cov, if it was already computed)
 	print(" morphing")
-	G = covar(vecs) * 3.
+	G = (cov if cov is not None else covar(vecs)) * 3.
 	# 2. Find L such that L * L.T = G^-1
 	print("  invert+cholesky")
 	L = (~G).cholesky()
@@ -54,14 +85,15 @@ def morphing(vecs):
 	print(" morphing done")
 	return L.T
 
-def preprocess(sigs):
+def preprocess(sigs, cov=None):
 	"""
 	Take in a numpy array of sigs (C*z) and morph it. Return the matrix L^-1 and the morphed vectors (as a numpy ndarray)
+	cov is the covariance matrix of sigs, if it is already known (see covar_from_stats).
 	"""
 	if not isinstance(sigs, np.ndarray):
 		print("converting sigs to a numpy array")
 		sigs = np.asarray(sigs, dtype=np.float64)
-	L = morphing(sigs)
+	L = morphing(sigs, cov)
 	print(" multiplying by L")
 	#sigs =  [L * v for v in sigs]
 	sigs = sigs @ L.T
@@ -69,17 +101,58 @@ def preprocess(sigs):
 	Li = ~L
 	return Li, sigs
 
-def savestate(filename, Li, vecs):
+def to_bfloat16(x):
+	"""
+	Round float values to bfloat16 (the upper half of a float32, rounding to nearest even).
+	numpy has no bfloat16 type, so the result holds the raw bits as uint16.
+	"""
+	b = np.ascontiguousarray(x, dtype=np.float32).view(np.uint32)
+	b = b + 0x7fff + ((b >> 16) & 1)
+	return (b >> 16).astype(np.uint16)
+
+def from_bfloat16(b):
+	""" Inverse of to_bfloat16 (exact), returns float64 """
+	return (np.asarray(b, dtype=np.uint32) << 16).view(np.float32).astype(np.float64)
+
+# Storage types for the morphed vectors. The samples are small integers / 3 transformed by a
+# well-conditioned L, so 32 or even 16 bits per coefficient are plenty as long as the moments are
+# accumulated in float64 (descent.py and eht_descent do). bfloat16 is stored as '<u2' bit patterns.
+STORAGE_DTYPES = {
+	"float64": (np.float64, None),
+	"float32": (np.float32, lambda x: x.astype(np.float32)),
+	"bfloat16": (np.uint16, to_bfloat16),
+}
+
+def as_float64(vecs):
+	""" Morphed vectors as float64, whatever their storage type in STORAGE_DTYPES """
+	if vecs.dtype == np.uint16:
+		return from_bfloat16(vecs)
+	return np.asarray(vecs, dtype=np.float64)
+
+def savestate(filename, Li, vecs, dtype="float64", chunksize=65536):
 	assert isinstance(vecs, np.ndarray)
 	assert vecs.dtype == np.float64
 	np.save(filename + ".Li.npy", np.asarray(Li, dtype=np.float64), allow_pickle=False)
-	np.save(filename + ".vecs.npy", vecs, allow_pickle=False)
+	storage, convert = STORAGE_DTYPES[dtype]
+	if convert is None:
+		np.save(filename + ".vecs.npy", vecs, allow_pickle=False)
+		return
+	# Convert in chunks so that we never hold a second full-size copy
+	out = np.lib.format.open_memmap(filename + ".vecs.npy", mode='w+', dtype=storage, shape=vecs.shape)
+	for i in range(0, len(vecs), chunksize):
+		out[i:i+chunksize] = convert(vecs[i:i+chunksize])
+	out.flush()
+	del out
 
 if __name__ == "__main__":
-	from sys import argv
-	if len(argv) < 3:
-		print(f"Usage: {argv[0]} infile outfile\n  where infile contains the C*z\n  and output will be written to outfile.Li.npy and outfile.vecs.npy")
-		exit(1)
-	sigs = loadsigs(argv[1])
-	Li, sigs = preprocess(sigs)
-	savestate(argv[2], Li, sigs)
+	import argparse
+	parser = argparse.ArgumentParser(description="Morph C*z samples so that C becomes approximately orthogonal.")
+	parser.add_argument("infile", help="file containing the C*z, as written by 02_process_signatures.sh, or PREFIX.cz.npy written by c_utils/eht_pipeline")
+	parser.add_argument("--stats", help="PREFIX.stats.npy written by c_utils/eht_pipeline; the covariance is computed from it instead of from the samples")
+	parser.add_argument("outfile", help="output will be written to outfile.Li.npy and outfile.vecs.npy")
+	parser.add_argument("--dtype", choices=STORAGE_DTYPES, default="float64", help="storage type of the morphed vectors")
+	args = parser.parse_args()
+	sigs = loadsigs(args.infile)
+	Li, sigs = preprocess(sigs, covar_from_stats(args.stats) if args.stats else None)
+	savestate(args.outfile, Li, sigs, args.dtype)
+	metrics.report("morphed_vectors", len(sigs))
@@ -1,5 +1,35 @@
-Q = 47
-M = 460
-N = 242
-K = 2
-D = N * K - M
+import json
+import os
+import subprocess
+
+"""
+The EHTv3 parameter set, as generated by c_utils/eht_print_params (00_setup.sh
+writes it to data/params.json). EHT_PARAMS overrides the path. If the file does
+not exist, the parameters are read from c_utils/eht_print_params directly.
+"""
+
+_root = os.path.dirname(os.path.abspath(__file__))
+
+def _load():
+    path = os.environ.get("EHT_PARAMS", os.path.join(_root, "data", "params.json"))
+    if os.path.exists(path):
+        with open(path) as f:
+            return json.load(f)
+    try:
+        out = subprocess.check_output([os.path.join(_root, "c_utils", "eht_print_params")])
+    except (subprocess.CalledProcessError, FileNotFoundError) as e:
+        raise RuntimeError(f"{path} does not exist and c_utils/eht_print_params failed ({e}); "
+                           "run \"make -C c_utils eht_print_params\", or 00_setup.sh to generate data/params.json") from e
+    return json.loads(out)
+
+PARAMS = _load()
+
+Q = PARAMS["Q"]
+M = PARAMS["M"]
+N = PARAMS["N"]
+K = PARAMS["K"]
+D = PARAMS["D"]
+# A signature verifies if at least L entries of the error C z are at most S (centered)
+S = PARAMS["S"]
+L = PARAMS["L"]
+assert D == N * K - M
@@ -1,39 +1,182 @@
 import argparse
-from keys import load_public, load_private
+from concurrent.futures import ProcessPoolExecutor, as_completed
+import hashlib
+from keys import load_public, load_private, save_ehtk
+from params import Q, K
+import metrics
 import json
-from sage.all import (
-    GF, Matrix, identity_matrix, vector,
-    random_matrix, set_random_seed, randint,
-)
+import multiprocessing
+import numpy as np
+try:
+    import gf47
+except OSError:
+    # c_utils/libgf47.so has not been built; it is only needed with --native
+    gf47 = None
+
+def import_sage():
+    # Sage is only needed without --native: the native path works on numpy arrays
+    # and c_utils/libgf47.so alone
+    global GF, Matrix, identity_matrix, vector, random_matrix, set_random_seed, randint
+    from sage.all import (
+        GF, Matrix, identity_matrix, vector,
+        random_matrix, set_random_seed, randint,
+    )
+
+def to_numpy(M):
+    # Sage matrix over GF(q) -> numpy array of residues
+    return np.array([int(x) for x in M.list()], dtype=np.int64).reshape(M.nrows(), M.ncols())
+
+# Worker process state for the parallel search (see recover_column_order_of_C_parallel)
+_worker_problem = None
+_worker_epoch = None
+
+def _init_probe_worker(problem, epoch):
+    global _worker_problem, _worker_epoch
+    _worker_problem = problem
+    _worker_epoch = epoch
+
+def _probe_branch(C_cols_known, WC, depth, epoch):
+    # Runs in a worker: gives up as soon as the search that submitted it has moved on
+    cancelled = lambda: _worker_epoch.value != epoch
+    return _worker_problem.probe(C_cols_known, WC, depth, cancelled)
 
 class EHTRecoveryFromColumns:
-    def __init__(self, pub, C_cols, priv=None, verbose=False):
+    def __init__(self, pub, C_cols, priv=None, verbose=False, native=False):
+        # With native=True, the linear algebra runs in c_utils/libgf47.so (see gf47.py)
+        # instead of Sage, and all matrices (pub.A included, see load_public) are numpy
+        # arrays of residues; Sage is not imported at all.
         self.pub = pub
         self.verbose = verbose
+        self.native = native
+        assert not native or gf47 is not None, "build c_utils/libgf47.so first"
 
         self.A = self.pub.A
-        self.k = 2
-        self.m = self.A.nrows()
-        self.n = self.A.ncols()
-        self.q = 47
-        self.Zq = GF(self.q)
-
-        self.C_cols = [vector(self.Zq, Ci) for Ci in C_cols]
+        self.k = K
+        self.q = Q
+        if native:
+            self.m, self.n = self.A.shape
+            self.C_cols = [np.array(Ci, dtype=np.int64) % self.q for Ci in C_cols]
+            # All candidate columns side by side
+            self.C_candidates = np.array(self.C_cols).T
+        else:
+            import_sage()
+            self.m = self.A.nrows()
+            self.n = self.A.ncols()
+            self.Zq = GF(self.q)
+            self.C_cols = [vector(self.Zq, Ci) for Ci in C_cols]
+            self.C_candidates = Matrix(self.Zq, self.C_cols).T
+        # step_cache[s] is the state (see reduced_candidates) after the first s pairs of
+        # columns were found, along the path that recover_column_order_of_C succeeded with
+        self.step_cache = {}
+        # Steps of the column ordering taken so far (reported as a metric)
+        self.steps = 0
 
     def log(self, *args, **kwargs):
         if self.verbose:
             print(*args, **kwargs)
 
+    # Linear algebra on Sage matrices, or on numpy arrays through gf47 when self.native is set
+
+    def left_kernel_matrix(self, M):
+        if self.native:
+            return gf47.left_kernel(M).astype(np.int64)
+        return Matrix(M.left_kernel().basis())
+
+    def echelon_form(self, M):
+        if self.native:
+            return gf47.rref(M)[0].astype(np.int64)
+        return M.echelon_form()
+
+    def solve_right(self, M, B):
+        if self.native:
+            return gf47.solve_right(M, B).astype(np.int64)
+        return M.solve_right(B)
+
+    def is_invertible(self, M):
+        if self.native:
+            return gf47.is_invertible(M)
+        return M.is_invertible()
+
     def build_C_right(self, C_cols_known):
+        if self.native:
+            return np.array([sgn * self.C_cols[ind] for ind, sgn in C_cols_known]).T % self.q
         C_right = Matrix(self.Zq, self.m, len(C_cols_known))
         for i, (ind, sgn) in enumerate(C_cols_known):
             C_right[:,i] = sgn * self.C_cols[ind]
         return C_right
 
-    def recover_next_column_pair_of_C(self, C_cols_known=[]):
+    def reduced_candidates(self, M=None):
+        # Returns W * C_candidates (or W * M), where the rows of W are a basis of the left kernel of A.
+        #
+        # This is the state that recover_next_column_pair_of_C works with. Once all rows of W
+        # are also orthogonal to the known columns of C (C_right), a vector x satisfies
+        #     W x = 0  <=>  x \in span(A) + span(C_right)  <=>  K x \in span(KA)
+        # for K the left kernel of C_right, which is the test we need. So instead of
+        # recomputing K and the echelon form of KA at every step, we only need to update
+        # W whenever a column becomes known, see restrict_to_left_kernel.
+        if M is None:
+            M = self.C_candidates
+        if self.native:
+            W = gf47.left_kernel(self.A)
+            return gf47.mul(W, M)
+        W = Matrix(self.A.left_kernel().basis())
+        return W * M
+
+    def columns_as_numpy(self, WC, inds):
+        # Selected columns of a state, as a numpy array
+        if self.native:
+            return WC[:, inds].astype(np.int64)
+        return to_numpy(WC.matrix_from_columns(inds))
+
+    def restrict_to_left_kernel(self, WC, ind):
+        # Given WC = W * C_candidates, returns W' * C_candidates where W' spans the vectors
+        # w in the row span of W with w * C_cols[ind] = 0.
+        # This is a rank-1 update: clear column ind using one row with a nonzero entry
+        # there as the pivot, then drop that row.
+        if self.native:
+            nonzero = np.flatnonzero(WC[:, ind])
+            if len(nonzero) == 0:
+                return WC
+            p = nonzero[0]
+            col = WC[:, ind].astype(np.int64) * pow(int(WC[p, ind]), self.q - 2, self.q)
+            WC = (WC - np.outer(col, WC[p])) % self.q
+            return np.delete(WC, p, axis=0).astype(np.uint8)
+        p = 0
+        while p < WC.nrows() and WC[p, ind] == 0:
+            p += 1
+        if p == WC.nrows():
+            # C_cols[ind] is already in the span
+            return WC
+        WC = WC - WC[p, ind]**-1 * (WC[:, ind] * WC[p:p+1, :])
+        return WC.delete_rows([p])
+
+    def normalize_columns(self, V):
+        # Scales every column of V (a numpy array of residues mod q) so that its first
+        # nonzero entry is 1. Returns the normalized columns (as rows, packed as bytes)
+        # and the scales, so that V[:,i] = scales[i] * normalized[i].
+        # Zero columns stay zero and get scale 0.
+        V = V.T
+        first = (V != 0).argmax(axis=1)
+        scales = V[np.arange(len(V)), first]
+        inverses = np.array([0] + [pow(a, self.q - 2, self.q) for a in range(1, self.q)])
+        normalized = (V * inverses[scales][:, None]) % self.q
+        return normalized.astype(np.uint8), scales
+
+    def candidate_index(self, normalized, scales):
+        # Hashed index of the normalized candidates:
+        # 64-bit fingerprint -> [(index, scale), ...]
+        index = {}
+        for i in range(len(normalized)):
+            key = hashlib.blake2b(normalized[i].tobytes(), digest_size=8).digest()
+            index.setdefault(key, []).append((i, int(scales[i])))
+        return index
+
+    def recover_next_column_pair_of_C(self, C_cols_known=[], WC=None):
         # Given the known columns, return all possible values
         # which include the next pair of known columns.
-        
+        # WC is reduced_candidates() restricted to the left kernel of the known columns;
+        # every value is yielded together with WC restricted further by the new pair.
+
         l = len(C_cols_known) // 2
         # We know CT = AB, and we know 2l of the rightmost columns of C.
         # We wish to determine the left kernel K of the rightmost columns of C
@@ -49,93 +192,141 @@ class EHTRecoveryFromColumns:
         # are correct for these indices. We want to find indices i, j such that
         # K * sgn_i * C_cols[i] * 1 + K * sgn_j * C_cols[j] * 7 \in span(KA)
         # WLOG, we can assume sgn_j = 1.
-        # We compute v_i = K*C_cols[i] and subtract columns of KA until the leading
-        # entries of v_i are all 0. Then, we just need to find i, j, sgn_i such that
+        # That is the case iff W * (sgn_i * C_cols[i] + 7 * C_cols[j]) = 0 (see
+        # reduced_candidates), so with v_i = W*C_cols[i] we just need to find i, j, sgn_i such that
         #     sgn_i * v_i + 7 * v_j = 0
         # which we can do with a meet-in-the-middle attack.
-        if l > 0:
-            C_right = self.build_C_right(C_cols_known)
-            K = Matrix(C_right.left_kernel().basis())
-        else:
-            K = identity_matrix(self.Zq, self.m)
-
-        KA = K * self.A
-
-        # Build matrix of remaining candidates
-        KC_candidates = Matrix(self.Zq, K.nrows(), len(self.C_cols) - 2*l)
-        ind = 0
-        index_map_original_C_cols = []
-        for i, Ci in enumerate(self.C_cols):
-            if i in [rec for rec, _ in C_cols_known]:
-                # Already used i
-                continue
-            KC_candidates[:,ind] = K * self.C_cols[i]
-            index_map_original_C_cols += [i]
-            ind += 1
-        assert ind == len(self.C_cols) - 2*l
-
-        # Zero out the top entries of KC_candidates
-        # Get column echelon form of KA
-        KA_echelon = KA.T.echelon_form().T
-        ncols = KA_echelon.rank()
-        KA_echelon = KA_echelon[:,:ncols]
-        inds_to_clear = []
-        for i in range(ncols):
-            j = 0
-            while j < KA_echelon.nrows() and KA_echelon[j,i] == 0:
-                j += 1
-            assert j != KA_echelon.nrows()
-            assert KA_echelon[j,i] == 1
-            inds_to_clear += [j]
-
-        KC_candidates -= KA_echelon * KC_candidates[inds_to_clear]
-        assert KC_candidates[:KA_echelon.nrows()-KA_echelon.ncols()].is_zero()
-
-        # Get list of candidates
-        v_s = KC_candidates.columns()
+        if WC is None:
+            WC = self.reduced_candidates()
+            for ind, _ in C_cols_known:
+                WC = self.restrict_to_left_kernel(WC, ind)
+
+        # Get list of remaining candidates
+        used = set(rec for rec, _ in C_cols_known)
+        index_map_original_C_cols = [i for i in range(len(self.C_cols)) if i not in used]
+        assert len(index_map_original_C_cols) == len(self.C_cols) - 2*l
+        v_s = WC.astype(np.int64) if self.native else to_numpy(WC)
+        v_s = v_s[:, index_map_original_C_cols]
 
         # Do meet in the middle attack.
-        for j in range(len(v_s)):
-            v_j = v_s[j]
+        # sgn_i * v_i = -7 * v_j means that v_i and v_j are multiples of the same normalized
+        # vector, with scales s_i = -7 * sgn_i * s_j. So one pass builds a hashed index of the
+        # normalized candidates and a second pass looks up the partners of every v_j.
+        # All matches are enumerated, in case several candidates reduce to the same vector.
+        normalized, scales = self.normalize_columns(v_s)
+        index = self.candidate_index(normalized, scales)
+        for j in range(len(normalized)):
+            key = hashlib.blake2b(normalized[j].tobytes(), digest_size=8).digest()
 
             for sgn_i in [-1, 1]:
-                v_i = sgn_i * -7 * v_j
-                if v_i in v_s:
-                    # sgn_i * v_i = -7 * v_j
-                    i = v_s.index(v_i)
-                    if i == j:
+                target = (-7 * sgn_i * int(scales[j])) % self.q
+                for i, scale in index[key]:
+                    if i == j or scale != target:
+                        continue
+                    if not np.array_equal(normalized[i], normalized[j]):
+                        # Fingerprint collision
                         continue
 
                     # Map back to indices in self.C_cols
                     I = index_map_original_C_cols[i]
                     J = index_map_original_C_cols[j]
 
-                    yield [(I, sgn_i), (J, 1)] + C_cols_known
+                    next_WC = self.restrict_to_left_kernel(self.restrict_to_left_kernel(WC, I), J)
+                    yield [(I, sgn_i), (J, 1)] + C_cols_known, next_WC
         return None
 
-    def recover_column_order_of_C(self, C_cols_known=[]):
+    def recover_column_order_of_C(self, C_cols_known=[], WC=None):
         # Recursive call to determine the order of columns in C.
         # Returns a list of 2*l tuples (ind, sgn) corresponding to the
         # rightmost 2*l columns of C, as specified by their index in
         # self.C_cols and their sign.
+        # Every level of the recursion keeps its own WC, so backtracking
+        # simply goes back to the caller's copy.
         assert self.k == 2
 
+        if WC is None:
+            WC = self.reduced_candidates()
+            for ind, _ in C_cols_known:
+                WC = self.restrict_to_left_kernel(WC, ind)
+
         if len(C_cols_known) >= self.k * (self.m - self.n - 1):
             # We cannot recover any more columns than this
             return C_cols_known
 
-        for next_C_cols_known in self.recover_next_column_pair_of_C(C_cols_known):
+        for next_C_cols_known, next_WC in self.recover_next_column_pair_of_C(C_cols_known, WC):
             self.log(f"Found pair for step {len(C_cols_known)//2}: {next_C_cols_known[:2]}")
-            all_C_cols_known = self.recover_column_order_of_C(next_C_cols_known)
+            self.steps += 1
+            all_C_cols_known = self.recover_column_order_of_C(next_C_cols_known, next_WC)
             if all_C_cols_known is None:
                 # We guessed wrong. Keep trying.
                 continue
             else:
+                # Keep the state of every step on the successful path for recover_T
+                self.step_cache[len(C_cols_known) // 2] = WC
                 return all_C_cols_known
 
         return None
 
-    def recover_T(self, C):
+    def probe(self, C_cols_known, WC, depth, cancelled=lambda: False):
+        # Depth-first search like recover_column_order_of_C, but only for depth more steps.
+        # Returns True if the branch C_cols_known stays consistent for that long (or completes).
+        if depth == 0 or len(C_cols_known) >= self.k * (self.m - self.n - 1):
+            return True
+        for next_C_cols_known, next_WC in self.recover_next_column_pair_of_C(C_cols_known, WC):
+            if cancelled():
+                return False
+            if self.probe(next_C_cols_known, next_WC, depth - 1, cancelled):
+                return True
+        return False
+
+    def recover_column_order_of_C_parallel(self, pool, epoch, depth, C_cols_known=[], WC=None):
+        # Same search as recover_column_order_of_C, but whenever there are several candidate
+        # pairs for the next step, all of them are probed for depth further steps at once on
+        # the worker pool (each probe gets its own snapshot of WC). As soon as one of them is
+        # confirmed, the sibling probes are cancelled and the search continues with it.
+        # The other branches that were not refuted are kept to backtrack to, in their
+        # original order, so the result is still found if the confirmed branch fails later.
+        # epoch is a shared counter; bumping it cancels all running probes.
+        assert self.k == 2
+
+        if WC is None:
+            WC = self.reduced_candidates()
+            for ind, _ in C_cols_known:
+                WC = self.restrict_to_left_kernel(WC, ind)
+
+        if len(C_cols_known) >= self.k * (self.m - self.n - 1):
+            return C_cols_known
+
+        branches = list(self.recover_next_column_pair_of_C(C_cols_known, WC))
+        if len(branches) > 1:
+            self.log(f"Probing {len(branches)} candidate pairs for step {len(C_cols_known)//2}")
+            with epoch.get_lock():
+                epoch.value += 1
+                current = epoch.value
+            futures = {pool.submit(_probe_branch, nxt, nWC, depth, current): i for i, (nxt, nWC) in enumerate(branches)}
+            # A confirmed branch is only taken once every branch before it is refuted,
+            # so that the search takes the same path as recover_column_order_of_C
+            results = {}
+            for future in as_completed(futures):
+                results[futures[future]] = future.result()
+                first = next((i for i in range(len(branches)) if results.get(i) is not False), None)
+                if first is not None and results.get(first):
+                    with epoch.get_lock():
+                        epoch.value += 1
+                    break
+            branches = [branches[i] for i in range(len(branches)) if results.get(i) is not False]
+
+        for next_C_cols_known, next_WC in branches:
+            self.log(f"Found pair for step {len(C_cols_known)//2}: {next_C_cols_known[:2]}")
+            self.steps += 1
+            all_C_cols_known = self.recover_column_order_of_C_parallel(pool, epoch, depth, next_C_cols_known, next_WC)
+            if all_C_cols_known is not None:
+                self.step_cache[len(C_cols_known) // 2] = WC
+                return all_C_cols_known
+
+        return None
+
+    def recover_T(self, C, column_order=None):
         # Once again, recall we have CT = AB, and depending on the choice of left kernel K,
         # KCT = KAB with some of the final rows of T having no effect on the matrix multiplication.
         # Our attack is thus to compute KC such that KCT only depends on a single pair of
@@ -161,79 +352,68 @@ class EHTRecoveryFromColumns:
         #
         # We thus are searching for scalar u' such that a particular column of KCT is in the
         # linear span of A. Do this.
+        #
+        # As in recover_next_column_pair_of_C, "K x in span(KA)" is tested as W_s x = 0, where
+        # W_s spans the left kernel of A and of the rightmost 2s columns of C. These are the
+        # states recover_column_order_of_C went through, so if column_order (its result) is
+        # given, W_s * C is read off its step_cache instead of being computed again.
         assert self.k == 2
-        l = C.ncols() // self.k
-        row_pairs_remaining = l
+        ncols = C.shape[1] if self.native else C.ncols()
+        l = ncols // self.k
+
+        # W_s * C = states[s][:,inds] * signs
+        if column_order is not None and all(s in self.step_cache for s in range(l)):
+            states = [self.step_cache[s] for s in range(l)]
+            inds = [ind for ind, _ in column_order]
+            signs = np.array([int(sgn) for _, sgn in column_order])
+        else:
+            WC = self.reduced_candidates(C)
+            states = []
+            for s in range(l):
+                states.append(WC)
+                for ind in [ncols - 2*s - 1, ncols - 2*s - 2]:
+                    WC = self.restrict_to_left_kernel(WC, ind)
+            inds = list(range(ncols))
+            signs = np.ones(ncols, dtype=np.int64)
 
         # C and T are not full size, but they do not need to be for this step
-        T = Matrix(self.Zq, 2 * l, l)
+        T = np.zeros((2 * l, l), dtype=np.int64)
 
-        while row_pairs_remaining > 0:
+        for row_pairs_remaining in range(l, 0, -1):
             row = 2 * (l - row_pairs_remaining)
-
-            if row_pairs_remaining > 1:
-                C_right = C[:,-(row_pairs_remaining-1)*2:]
-                K = Matrix(C_right.left_kernel().basis())
-            else:
-                K = identity_matrix(self.Zq, C.nrows())
-            KC = K * C
-
-            # Get column echelon form of KA
-            KA = K * self.A
-            KA_echelon = KA.T.echelon_form().T
-            ncols = KA_echelon.rank()
-            KA_echelon = KA_echelon[:,:ncols]
-            inds_to_clear = []
-            for i in range(ncols):
-                j = 0
-                while j < KA_echelon.nrows() and KA_echelon[j,i] == 0:
-                    j += 1
-                assert j != KA_echelon.nrows()
-                assert KA_echelon[j,i] == 1
-                inds_to_clear += [j]
+            diag = l - row_pairs_remaining
+            WsC = self.columns_as_numpy(states[row_pairs_remaining - 1], inds) * signs % self.q
 
             # Diagonal is known
-            T[row, l - row_pairs_remaining] = 1
-            T[row + 1, l - row_pairs_remaining] = 7
-
-            for col in range(l - row_pairs_remaining):
-                # Recover subdiagonal entries in row
-                # The column in KCT we care about is
-                # (KCT)[:,col] = (KC[:,:row+1])(T[:,col])
-                # = KC[:,:row] * T[:row, col] + KC[:,row]T[row, col] + KC[:,row+1]T[row + 1, col]
-                # = KC[:,:row] * T[:row, col] + 0 + KC[:,row+1]u1
-                T[row, col] = 0
-                T[row+1, col] = 0
-                KCT_col = KC * T[:,col]
-                v = KC[:,row+1]
-
-                # Reduce KCT_col by columns of KA
-                KCT_col -= KA_echelon * KCT_col[inds_to_clear]
-
-                # Reduce v by columns of KA
-                v -= KA_echelon * v[inds_to_clear]
-
-                # What value of u will satisfy
-                #     0 = KCT_col + u * v
-                v_nonzero_ind = 0
-                assert not v.is_zero()
-                while v[v_nonzero_ind] == 0:
-                    v_nonzero_ind += 1
-
-                u = -KCT_col[v_nonzero_ind,0] * v[v_nonzero_ind,0]**-1
-
-                assert (KCT_col + u * v).is_zero()
-                T[row,col] = 0
-                T[row+1,col] = u
+            T[row, diag] = 1
+            T[row + 1, diag] = 7
+
+            if diag > 0:
+                # Recover subdiagonal entries in row, for all columns to the left at once.
+                # The columns of W_s C T we care about are
+                # (W_s C T)[:,col] = (W_s C)[:,:row] * T[:row, col] + (W_s C)[:,row+1] * u
+                # and we need the value of u that makes them 0
+                KCT = WsC[:, :row] @ T[:row, :diag] % self.q
+                v = WsC[:, row + 1]
+                nonzero = np.flatnonzero(v)
+                assert len(nonzero) > 0
+                p = nonzero[0]
+                u = -KCT[p] * pow(int(v[p]), self.q - 2, self.q) % self.q
+
+                assert ((KCT + np.outer(v, u)) % self.q == 0).all()
+                T[row + 1, :diag] = u
 
             self.log(f"Remaining rows: {row_pairs_remaining}")
-            row_pairs_remaining -= 1
-        return T
+        if self.native:
+            return T
+        return Matrix(self.Zq, T.tolist())
 
     def fill_in_remainder(self, C_part, T_part):
         # Come up with C, T, B such that C is sparse, T is lower triangular
         # (except for a bit at the top), B is invertible, and CT = AB.
         assert self.k == 2
+        if self.native:
+            return self.fill_in_remainder_native(C_part, T_part)
         l = C_part.ncols() // 2
 
         # Make slightly larger than square to allow flexibility
@@ -248,15 +428,15 @@ class EHTRecoveryFromColumns:
         # Some of B can be determined from what we have already,
         # since we know the rightmost l columns of CT, which match
         # the rightmost columns of AB.
-        B[:,-l:] = self.A.solve_right((C*T)[:,-l:])
+        B[:,-l:] = self.solve_right(self.A, (C*T)[:,-l:])
 
         # Randomly fill in the rest until B is invertible
         set_random_seed(3)
-        while not B.is_invertible():
+        while not self.is_invertible(B):
             B[:,:-l] = random_matrix(self.Zq, self.n, self.n-l)
 
         # Randomly add entries to the unknown part of C until it's invertible
-        while not C[:,:self.m].is_invertible():
+        while not self.is_invertible(C[:,:self.m]):
             row = randint(0, C.nrows() - 1)
             col = randint(0, C.ncols() - 2*l - 1)
             C[row, col] += 1
@@ -265,28 +445,64 @@ class EHTRecoveryFromColumns:
         # This is not upper triangular, but it does not affect our ability
         # to solve CVP in T.
         # CT = AB
-        T[:,:T.ncols()-l] = C.solve_right((self.A * B)[:,:T.ncols()-l])
+        T[:,:T.ncols()-l] = self.solve_right(C, (self.A * B)[:,:T.ncols()-l])
+
+        return C, T, B
+
+    def fill_in_remainder_native(self, C_part, T_part):
+        # Same as fill_in_remainder, on numpy arrays and with numpy's random generator
+        l = C_part.shape[1] // 2
+        q = self.q
+
+        C = np.zeros((self.m, self.m + 1), dtype=np.int64)
+        C[:,-2*l:] = C_part
+
+        T = np.zeros((self.m + 1, self.n), dtype=np.int64)
+        T[-2*l:,-l:] = T_part
+
+        B = np.zeros((self.n, self.n), dtype=np.int64)
+        B[:,-l:] = self.solve_right(self.A, (C @ T)[:,-l:] % q)
+
+        rng = np.random.default_rng(3)
+        while not self.is_invertible(B):
+            B[:,:-l] = rng.integers(0, q, (self.n, self.n - l))
+
+        while not self.is_invertible(C[:,:self.m]):
+            row = rng.integers(0, C.shape[0])
+            col = rng.integers(0, C.shape[1] - 2*l)
+            C[row, col] = (C[row, col] + 1) % q
+
+        T[:,:T.shape[1]-l] = self.solve_right(C, (self.A @ B)[:,:T.shape[1]-l] % q)
 
         return C, T, B
 
+    def key_as_arrays(self, C, T, B):
+        if self.native:
+            return {"C": C, "T": T, "B": B}
+        return {"C": to_numpy(C), "T": to_numpy(T), "B": to_numpy(B)}
+
     def key_as_json(self, C, T, B):
-        data = {}
-        C = [[int(cij) for cij in Ci] for Ci in C.rows()]
-        T = [[int(tij) for tij in Ti] for Ti in T.rows()]
-        B = [[int(bij) for bij in Bi] for Bi in B.rows()]
-
-        data["C"] = C
-        data["T"] = T
-        data["B"] = B
+        data = {name: mat.tolist() for name, mat in self.key_as_arrays(C, T, B).items()}
         return json.dumps(data)
 
-    def solve(self):
-        column_order = self.recover_column_order_of_C()
+    def solve(self, jobs=1, confirm_depth=4, as_json=True):
+        # Returns the partial key as JSON, or (as_json=False) as a dict of numpy arrays
+        # With jobs > 1, competing branches of the column ordering are probed in parallel
+        if jobs > 1:
+            # fork, so that the workers inherit self instead of unpickling it
+            ctx = multiprocessing.get_context("fork")
+            epoch = ctx.Value('i', 0)
+            with ProcessPoolExecutor(jobs, mp_context=ctx, initializer=_init_probe_worker, initargs=(self, epoch)) as pool:
+                column_order = self.recover_column_order_of_C_parallel(pool, epoch, confirm_depth)
+        else:
+            column_order = self.recover_column_order_of_C()
         C_part = self.build_C_right(column_order)
-        T_part = self.recover_T(C_part)
+        T_part = self.recover_T(C_part, column_order)
         C, T, B = self.fill_in_remainder(C_part, T_part)
 
         # Columns of t not lower triangular
+        if not as_json:
+            return self.key_as_arrays(C, T, B)
         key = self.key_as_json(C, T, B)
 
         return key
@@ -297,11 +513,14 @@ def main():
     )
     parser.add_argument('pub', type=str, help="Public key generated by eht_print_pk")
     parser.add_argument('cols', type=str, help="File containing columns of C")
-    parser.add_argument('priv', type=str, help="Where to write private key")
+    parser.add_argument('priv', type=str, help="Where to write private key (binary container if it ends in .ehtk, JSON otherwise)")
     parser.add_argument('--verbose', '-v', action='store_true', help="enable verbose output")
+    parser.add_argument('--native', action='store_true', help="run without Sage: linear algebra in c_utils/libgf47.so on numpy arrays")
+    parser.add_argument('--jobs', '-j', type=int, default=1, help="probe competing candidate pairs on this many processes")
+    parser.add_argument('--confirm-depth', type=int, default=4, help="steps a probed branch has to survive before its siblings are cancelled")
     args = parser.parse_args()
 
-    pub = load_public(args.pub)
+    pub = load_public(args.pub, native=args.native)
     
     with open(args.cols) as f:
         cols = []
@@ -314,13 +533,19 @@ def main():
 
     #pub, cols, priv = gen_bd()
 
-    problem = EHTRecoveryFromColumns(pub, cols, verbose=args.verbose)
+    problem = EHTRecoveryFromColumns(pub, cols, verbose=args.verbose, native=args.native)
 
-    priv = problem.solve()
+    binary = args.priv.endswith(".ehtk")
+    priv = problem.solve(args.jobs, args.confirm_depth, as_json=not binary)
 
     print("Key recovery successful.")
-    with open(args.priv, "w") as g:
-        g.write(priv)
+    # Steps of the column ordering taken, including those that were backtracked
+    metrics.report("recovery_steps", problem.steps)
+    if binary:
+        save_ehtk(args.priv, **priv)
+    else:
+        with open(args.priv, "w") as g:
+            g.write(priv)
     
 
 if __name__ == "__main__":
@@ -0,0 +1,378 @@
+import argparse
+import glob
+import hashlib
+import html
+import json
+import os
+import platform
+import signal
+import subprocess
+import sys
+import threading
+import time
+
+import metrics
+
+"""
+Runs the numbered stages of the attack (00_setup.sh .. 06_signature_forgery.sh) one
+after the other and profiles each of them: wall time, CPU time and utilization, peak
+RSS, bytes read and written, and the counters the stages report (see metrics.py),
+e.g. signatures, Cz rows or descent iterations per second.
+
+Each stage runs in its own session. While it runs, /proc is sampled every --interval
+seconds for all processes of that session (number of processes, their total RSS and
+CPU usage) and for the system-wide iowait; these samples give the timeline and the
+peak RSS. CPU time and I/O bytes are exact totals over the whole process tree: they
+are taken from the stage's shell after it has exited, which by then has collected
+them from all of its children.
+
+The report is written to REPORT_DIR/<run id>.json and .html. It records the host,
+the git commit and the knobs the stages read from the environment, so that runs
+can be compared: the HTML report has a table of all earlier reports in REPORT_DIR,
+and --compare OLD.json adds the ratio to that run for every stage.
+"""
+
+_root = os.path.dirname(os.path.abspath(__file__))
+
+# Environment variables read by the stage scripts
+KNOBS = ["STREAM", "DTYPE", "UPDATE", "DESCENT", "COORDINATOR", "DESCENT_ARGS", "SEED", "NATIVE", "JOBS"]
+
+CLOCK_TICKS = os.sysconf("SC_CLK_TCK")
+PAGE_SIZE = os.sysconf("SC_PAGE_SIZE")
+
+def find_stages():
+    # {"01": "01_signature_generation.sh", ...}, without 99_debug.sh
+    stages = {}
+    for path in sorted(glob.glob(os.path.join(_root, "[0-9][0-9]_*.sh"))):
+        name = os.path.basename(path)
+        if not name.startswith("99"):
+            stages[name[:2]] = name
+    return stages
+
+def select_stages(spec, stages):
+    # spec is a comma separated list of stage numbers or ranges, e.g. "01-03,05"
+    if spec is None:
+        return list(stages)
+    selected = []
+    for part in spec.split(","):
+        first, _, last = part.partition("-")
+        for number in stages:
+            if int(first) <= int(number) <= int(last or first) and number not in selected:
+                selected.append(number)
+    return selected
+
+def read_file(path):
+    try:
+        with open(path) as f:
+            return f.read()
+    except OSError:
+        return None
+
+def read_io(pid):
+    # /proc/PID/io as a dict; for a zombie, this includes everything its reaped children did
+    text = read_file(f"/proc/{pid}/io")
+    if text is None:
+        return {}
+    io = {}
+    for line in text.splitlines():
+        key, _, value = line.partition(":")
+        io[key] = int(value)
+    return io
+
+def read_cpu_times():
+    # (total, iowait) jiffies over all CPUs, from /proc/stat
+    fields = [int(x) for x in read_file("/proc/stat").splitlines()[0].split()[1:]]
+    return sum(fields), fields[4]
+
+def session_processes(sid):
+    # {(pid, starttime): (utime + stime in ticks, rss in bytes)} for all processes of the session sid
+    procs = {}
+    for pid in os.listdir("/proc"):
+        if not pid.isdigit():
+            continue
+        stat = read_file(f"/proc/{pid}/stat")
+        if stat is None:
+            continue
+        # Fields after the command name, which may contain spaces; fields[i] is field i+3 of proc(5)
+        fields = stat[stat.rindex(")") + 2:].split()
+        if int(fields[3]) != sid:
+            continue
+        procs[(int(pid), fields[19])] = (int(fields[11]) + int(fields[12]), int(fields[21]) * PAGE_SIZE)
+    return procs
+
+class Sampler:
+    """ Samples the processes of one session at regular intervals """
+    def __init__(self, sid, start):
+        self.sid = sid
+        self.start = start
+        self.samples = []
+        self.last = (self.start, {}, read_cpu_times())
+
+    def sample(self):
+        now = time.monotonic()
+        procs = session_processes(self.sid)
+        cpu_times = read_cpu_times()
+        then, last_procs, last_cpu_times = self.last
+        # CPU time of the processes that were alive in both samples
+        ticks = sum(max(procs[p][0] - last_procs[p][0], 0) for p in procs if p in last_procs)
+        total = cpu_times[0] - last_cpu_times[0]
+        self.samples.append({
+            "t": round(now - self.start, 3),
+            "processes": len(procs),
+            "rss_bytes": sum(rss for _, rss in procs.values()),
+            "cpu_cores": round(ticks / CLOCK_TICKS / max(now - then, 1e-6), 3),
+            "iowait": round((cpu_times[1] - last_cpu_times[1]) / total, 3) if total > 0 else 0.0,
+        })
+        self.last = (now, procs, cpu_times)
+
+def forward_output(stream, log, counters):
+    # Copies the output of a stage to stdout and its log file, and collects the METRIC lines
+    for raw in stream:
+        line = raw.decode(errors="replace")
+        log.write(line)
+        parsed = metrics.parse(line)
+        if parsed is not None:
+            name, value = parsed
+            counters[name] = counters.get(name, 0) + value
+        else:
+            sys.stdout.write(line)
+            sys.stdout.flush()
+
+def bottleneck(stage, ncpus):
+    # Rough classification of what limited the stage, from its averages
+    samples = stage["samples"]
+    iowait = sum(s["iowait"] for s in samples) / len(samples) if samples else 0.0
+    if iowait > 0.2:
+        return "io"
+    if stage["cpu_cores"] >= 0.75 * ncpus:
+        return "cpu"
+    if stage["cpu_cores"] >= 0.75:
+        return "cpu (partly parallel)"
+    return "latency"
+
+def run_stage(number, script, interval, log_path):
+    print(f"=== {script}", flush=True)
+    env = dict(os.environ, EHT_METRICS="1")
+    counters = {}
+    started = time.time()
+    start = time.monotonic()
+    with open(log_path, "w") as log:
+        p = subprocess.Popen(["bash", script], cwd=_root, env=env, stdout=subprocess.PIPE,
+                             stderr=subprocess.STDOUT, start_new_session=True)
+        reader = threading.Thread(target=forward_output, args=(p.stdout, log, counters), daemon=True)
+        reader.start()
+        sampler = Sampler(p.pid, start)
+        status = "ok"
+        try:
+            # Wait for the exit without reaping, so that /proc/PID/io still has the totals.
+            # The exit is checked more often than the samples are taken, for an exact wall time.
+            next_sample = start
+            while os.waitid(os.P_PID, p.pid, os.WEXITED | os.WNOHANG | os.WNOWAIT) is None:
+                if time.monotonic() >= next_sample:
+                    sampler.sample()
+                    next_sample += interval
+                time.sleep(min(interval, 0.01))
+        except KeyboardInterrupt:
+            status = "interrupted"
+            os.killpg(p.pid, signal.SIGTERM)
+            os.waitid(os.P_PID, p.pid, os.WEXITED | os.WNOWAIT)
+        wall = time.monotonic() - start
+        io = read_io(p.pid)
+        _, code, usage = os.wait4(p.pid, 0)
+        p.returncode = os.waitstatus_to_exitcode(code)
+        reader.join()
+    if status == "ok" and p.returncode != 0:
+        status = f"exit {p.returncode}"
+
+    with open(os.path.join(_root, script), "rb") as f:
+        script_hash = hashlib.sha1(f.read()).hexdigest()
+    cpu = usage.ru_utime + usage.ru_stime
+    samples = sampler.samples
+    return {
+        "stage": number,
+        "script": script,
+        "script_sha1": script_hash,
+        "status": status,
+        "started": started,
+        "wall_seconds": round(wall, 3),
+        "user_seconds": round(usage.ru_utime, 3),
+        "system_seconds": round(usage.ru_stime, 3),
+        "cpu_cores": round(cpu / wall, 3) if wall > 0 else 0.0,
+        "peak_rss_bytes": max([s["rss_bytes"] for s in samples] + [usage.ru_maxrss * 1024]),
+        "max_process_rss_bytes": usage.ru_maxrss * 1024,
+        "peak_processes": max([s["processes"] for s in samples] + [1]),
+        "bytes_read": io.get("rchar", 0),
+        "bytes_written": io.get("wchar", 0),
+        "disk_bytes_read": io.get("read_bytes", 0),
+        "disk_bytes_written": io.get("write_bytes", 0),
+        "metrics": {name: {"total": value, "per_second": round(value / wall, 3) if wall > 0 else 0.0}
+                    for name, value in sorted(counters.items())},
+        "samples": samples,
+        "log": os.path.relpath(log_path, _root),
+    }
+
+def host_info():
+    cpuinfo = read_file("/proc/cpuinfo") or ""
+    model = next((line.split(":", 1)[1].strip() for line in cpuinfo.splitlines() if line.startswith("model name")), platform.processor())
+    meminfo = read_file("/proc/meminfo") or ""
+    mem = next((int(line.split()[1]) * 1024 for line in meminfo.splitlines() if line.startswith("MemTotal:")), 0)
+    return {
+        "hostname": platform.node(),
+        "cpus": os.cpu_count(),
+        "cpu_model": model,
+        "memory_bytes": mem,
+        "kernel": platform.release(),
+        "python": platform.python_version(),
+    }
+
+def git_info():
+    def git(*args):
+        try:
+            return subprocess.check_output(["git", *args], cwd=_root, stderr=subprocess.DEVNULL).decode().strip()
+        except (OSError, subprocess.CalledProcessError):
+            return None
+    status = git("status", "--porcelain", "--untracked-files=no")
+    return {"commit": git("rev-parse", "HEAD"), "dirty": bool(status) if status is not None else None}
+
+def compare(report, old):
+    # Ratios new/old of the wall time and of the metric rates of every stage in both runs
+    old_stages = {s["stage"]: s for s in old["stages"]}
+    result = {"run_id": old["run_id"], "stages": {}}
+    for stage in report["stages"]:
+        before = old_stages.get(stage["stage"])
+        if before is None or before["wall_seconds"] == 0:
+            continue
+        ratios = {"wall_seconds": round(stage["wall_seconds"] / before["wall_seconds"], 3)}
+        for name, m in stage["metrics"].items():
+            rate = before["metrics"].get(name, {}).get("per_second")
+            if rate:
+                ratios[name + "_per_second"] = round(m["per_second"] / rate, 3)
+        result["stages"][stage["stage"]] = ratios
+    return result
+
+def human_bytes(n):
+    for unit in ["B", "KiB", "MiB", "GiB", "TiB"]:
+        if abs(n) < 1024 or unit == "TiB":
+            return f"{n:.0f} {unit}" if unit == "B" else f"{n:.1f} {unit}"
+        n /= 1024
+
+def sparkline(values, width=300, height=40):
+    # Inline SVG of a series, scaled to its maximum
+    if len(values) < 2:
+        return ""
+    step = max(1, len(values) // width)
+    values = values[::step]
+    top = max(values) or 1
+    points = " ".join(f"{i * width / (len(values) - 1):.1f},{height - v * height / top:.1f}" for i, v in enumerate(values))
+    return (f'<svg width="{width}" height="{height}"><polyline fill="none" stroke="steelblue" points="{points}"/></svg>'
+            f' <small>max {top:g}</small>')
+
+def history(report_dir):
+    runs = []
+    for path in glob.glob(os.path.join(report_dir, "*.json")):
+        try:
+            with open(path) as f:
+                runs.append(json.load(f))
+        except (OSError, ValueError):
+            continue
+    return sorted((r for r in runs if "stages" in r), key=lambda r: r["started"])
+
+def write_html(report, path, runs):
+    e = html.escape
+    out = [f"<!DOCTYPE html><html><head><meta charset='utf-8'><title>Pipeline run {e(report['run_id'])}</title>",
+           "<style>body{font-family:sans-serif}table{border-collapse:collapse;margin-bottom:1em}"
+           "td,th{border:1px solid #ccc;padding:2px 6px;text-align:right}th{background:#eee}</style></head><body>",
+           f"<h1>Pipeline run {e(report['run_id'])}</h1>",
+           f"<p>{e(report['host']['hostname'])}: {report['host']['cpus']} CPUs ({e(report['host']['cpu_model'])}), "
+           f"{human_bytes(report['host']['memory_bytes'])} memory; commit {e(str(report['git']['commit']))}"
+           f"{' (dirty)' if report['git']['dirty'] else ''}; knobs {e(json.dumps(report['knobs']))}</p>"]
+
+    ratios = report.get("compare", {}).get("stages", {})
+    out.append("<h2>Stages</h2><table><tr><th>stage</th><th>status</th><th>wall s</th><th>user s</th><th>sys s</th>"
+               "<th>CPU cores</th><th>peak RSS</th><th>read</th><th>written</th><th>disk read</th><th>disk written</th>"
+               "<th>bound by</th>" + ("<th>wall vs " + e(report["compare"]["run_id"]) + "</th>" if ratios else "") + "</tr>")
+    for s in report["stages"]:
+        ratio = ratios.get(s["stage"], {}).get("wall_seconds")
+        out.append(f"<tr><td>{e(s['script'])}</td><td>{e(s['status'])}</td><td>{s['wall_seconds']:.2f}</td>"
+                   f"<td>{s['user_seconds']:.2f}</td><td>{s['system_seconds']:.2f}</td><td>{s['cpu_cores']:.2f}</td>"
+                   f"<td>{human_bytes(s['peak_rss_bytes'])}</td><td>{human_bytes(s['bytes_read'])}</td>"
+                   f"<td>{human_bytes(s['bytes_written'])}</td><td>{human_bytes(s['disk_bytes_read'])}</td>"
+                   f"<td>{human_bytes(s['disk_bytes_written'])}</td><td>{e(s['bottleneck'])}</td>"
+                   + (f"<td>{ratio if ratio is not None else ''}</td>" if ratios else "") + "</tr>")
+    out.append("</table>")
+
+    out.append("<h2>Stage counters</h2><table><tr><th>stage</th><th>counter</th><th>total</th><th>per second</th>"
+               + ("<th>rate vs " + e(report["compare"]["run_id"]) + "</th>" if ratios else "") + "</tr>")
+    for s in report["stages"]:
+        for name, m in s["metrics"].items():
+            ratio = ratios.get(s["stage"], {}).get(name + "_per_second")
+            out.append(f"<tr><td>{e(s['script'])}</td><td>{e(name)}</td><td>{m['total']:g}</td><td>{m['per_second']:g}</td>"
+                       + (f"<td>{ratio if ratio is not None else ''}</td>" if ratios else "") + "</tr>")
+    out.append("</table>")
+
+    out.append("<h2>Timelines</h2><table><tr><th>stage</th><th>CPU cores</th><th>RSS (MiB)</th><th>iowait</th></tr>")
+    for s in report["stages"]:
+        samples = s["samples"]
+        out.append(f"<tr><td>{e(s['script'])}</td><td>{sparkline([x['cpu_cores'] for x in samples])}</td>"
+                   f"<td>{sparkline([round(x['rss_bytes'] / 2**20, 1) for x in samples])}</td>"
+                   f"<td>{sparkline([x['iowait'] for x in samples])}</td></tr>")
+    out.append("</table>")
+
+    numbers = sorted({s["stage"] for r in runs for s in r["stages"]})
+    out.append("<h2>History (wall seconds)</h2><table><tr><th>run</th><th>commit</th><th>host</th>"
+               + "".join(f"<th>{e(n)}</th>" for n in numbers) + "</tr>")
+    for r in runs:
+        walls = {s["stage"]: s["wall_seconds"] for s in r["stages"]}
+        commit = (r["git"]["commit"] or "")[:10]
+        out.append(f"<tr><td>{e(r['run_id'])}</td><td>{e(commit)}</td><td>{e(r['host']['hostname'])}</td>"
+                   + "".join(f"<td>{walls[n]:.2f}</td>" if n in walls else "<td></td>" for n in numbers) + "</tr>")
+    out.append("</table></body></html>")
+
+    with open(path, "w") as f:
+        f.write("\n".join(out) + "\n")
+
+def main():
+    stages = find_stages()
+    parser = argparse.ArgumentParser(description="Run the stages of the attack and write a profile of each of them.")
+    parser.add_argument("--stages", "-s", help="stages to run, e.g. 01-03,05 (default: all of " + ", ".join(stages) + ")")
+    parser.add_argument("--interval", type=float, default=0.5, help="seconds between two samples of /proc")
+    parser.add_argument("--report-dir", default=os.path.join(_root, "data", "reports"), help="where to write the reports")
+    parser.add_argument("--compare", help="earlier report (.json) to compare this run with")
+    parser.add_argument("--keep-going", action="store_true", help="run the remaining stages after one has failed")
+    args = parser.parse_args()
+
+    os.makedirs(args.report_dir, exist_ok=True)
+    run_id = time.strftime("%Y%m%d-%H%M%S")
+    report = {
+        "run_id": run_id,
+        "started": time.time(),
+        "host": host_info(),
+        "git": git_info(),
+        "knobs": {k: os.environ[k] for k in KNOBS if k in os.environ},
+        "stages": [],
+    }
+
+    for number in select_stages(args.stages, stages):
+        log_path = os.path.join(args.report_dir, f"{run_id}.{number}.log")
+        stage = run_stage(number, stages[number], args.interval, log_path)
+        stage["bottleneck"] = bottleneck(stage, report["host"]["cpus"])
+        report["stages"].append(stage)
+        print(f"=== {stage['script']}: {stage['status']}, {stage['wall_seconds']:.1f} s, "
+              f"{stage['cpu_cores']:.2f} CPU cores, peak RSS {human_bytes(stage['peak_rss_bytes'])}", flush=True)
+        if stage["status"] == "interrupted" or (stage["status"] != "ok" and not args.keep_going):
+            break
+
+    report["wall_seconds"] = round(sum(s["wall_seconds"] for s in report["stages"]), 3)
+    if args.compare:
+        with open(args.compare) as f:
+            report["compare"] = compare(report, json.load(f))
+
+    base = os.path.join(args.report_dir, run_id)
+    with open(base + ".json", "w") as f:
+        json.dump(report, f, indent=1)
+    write_html(report, base + ".html", history(args.report_dir))
+    print(f"Report written to {base}.json and {base}.html")
+    return 0 if all(s["status"] == "ok" for s in report["stages"]) else 1
+
+if __name__ == "__main__":
+    sys.exit(main())
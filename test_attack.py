@@ -53,8 +53,8 @@ def test_recovery_from_columns(priv, pub):
 
 def main():
     import sys
-    fn_sk = sys.argv[1] if len(sys.argv) > 1 else "debug/private.json"
-    fn_pk = sys.argv[2] if len(sys.argv) > 2 else "debug/public.json"
+    fn_sk = sys.argv[1] if len(sys.argv) > 1 else "debug/private.ehtk"
+    fn_pk = sys.argv[2] if len(sys.argv) > 2 else "debug/public.ehtk"
     
     priv = load_private(fn_sk)
     pub = load_public(fn_pk)
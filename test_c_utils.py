@@ -0,0 +1,103 @@
+import json
+import os
+import random
+import subprocess
+import tempfile
+
+import numpy as np
+
+from keys import load_matrices, load_ehtk, save_ehtk
+from params import Q
+
+"""
+Checks the behavior of the c_utils tools that the attack relies on, on a freshly
+generated KAT key (run "make -C c_utils" first):
+ - eht_keygen --range writes the same keys as generating them one index at a time,
+ - .ehtk files written by keys.py and by eht_print_sk read back as the same matrices,
+ - eht_colfilter drops sign-flipped and scaled copies of the same column of C.
+"""
+
+C_UTILS = os.path.join(os.path.dirname(os.path.abspath(__file__)), "c_utils")
+
+def run(tool, *args, **kwargs):
+    return subprocess.run([os.path.join(C_UTILS, tool)] + list(args), check=True, capture_output=True, **kwargs)
+
+def read(fname):
+    with open(fname, "rb") as f:
+        return f.read()
+
+def test_keygen_range(tmpdir):
+    run("eht_keygen", "--range", "1-3", "--outdir", tmpdir, "-t", "2")
+    for i in range(1, 4):
+        keydir = os.path.join(tmpdir, f"single{i}")
+        os.mkdir(keydir)
+        run("eht_keygen", str(i), cwd=keydir)
+        assert read(os.path.join(tmpdir, f"{i}.sk")) == read(os.path.join(keydir, "private.sk")), f"private key {i} differs"
+        assert read(os.path.join(tmpdir, f"{i}.pk")) == read(os.path.join(keydir, "public.pk")), f"public key {i} differs"
+    print("eht_keygen --range writes the same keys as eht_keygen KEY_INDEX")
+    return True
+
+def test_ehtk_roundtrip(tmpdir, sk):
+    # Odd shapes, so that the matrices need padding to the alignment
+    rng = np.random.default_rng(1)
+    mats = {"C": rng.integers(0, Q, (7, 13)), "T": rng.integers(-Q, Q, (1, 65)), "LONGNAME": rng.integers(0, Q, (64, 3))}
+    fname = os.path.join(tmpdir, "python.ehtk")
+    save_ehtk(fname, **mats)
+    loaded = load_ehtk(fname)
+    assert sorted(loaded) == sorted(mats)
+    for name, mat in mats.items():
+        assert np.array_equal(loaded[name], mat % Q), f"{name} differs after the round trip"
+
+    # The same private key through eht_print_sk, as JSON and as .ehtk
+    fname = os.path.join(tmpdir, "private.ehtk")
+    with open(os.path.join(tmpdir, "private.json"), "wb") as f:
+        f.write(run("eht_print_sk", sk).stdout)
+    run("eht_print_sk", sk, fname)
+    json_mats = load_matrices(os.path.join(tmpdir, "private.json"))
+    ehtk_mats = load_matrices(fname)
+    assert sorted(json_mats) == sorted(ehtk_mats) == ["B", "C", "T"]
+    for name in json_mats:
+        assert np.array_equal(json_mats[name], ehtk_mats[name]), f"{name} differs between JSON and .ehtk"
+    print(".ehtk files read back as the matrices that were written")
+    return True
+
+def normalize(v):
+    # v up to sign, as residues
+    v = np.asarray(v) % Q
+    w = -v % Q
+    return tuple(min(v.tolist(), w.tolist()))
+
+def test_colfilter_dedup(tmpdir, sk, pk):
+    fname = os.path.join(tmpdir, "dedup.ehtk")
+    run("eht_print_sk", sk, fname)
+    C = load_matrices(fname)["C"].astype(np.int64)
+    centered = np.where(C > Q // 2, C - Q, C)
+    random.seed(3)
+    picked = random.sample(range(C.shape[1]), 10)
+    lines = []
+    for j in picked:
+        col = centered[:, j]
+        # The column itself, its negation and scaled copies (as residues and centered)
+        for copy in (col, -col, 5 * col % Q, (-17 * col) % Q - Q):
+            lines.append("[" + ", ".join(str(x) for x in copy) + "]")
+    random.shuffle(lines)
+    out = run("eht_colfilter", pk, input=("\n".join(lines) + "\n").encode()).stdout.decode()
+    kept = [normalize(json.loads(line)) for line in out.splitlines() if line.strip()]
+    assert len(kept) == len(picked), f"{len(kept)} candidates kept out of {len(picked)} distinct columns"
+    assert sorted(kept) == sorted(normalize(C[:, j]) for j in picked), "eht_colfilter kept the wrong columns"
+    print("eht_colfilter keeps one copy of each column of C")
+    return True
+
+def main():
+    with tempfile.TemporaryDirectory() as tmpdir:
+        run("eht_keygen", "0", cwd=tmpdir)
+        sk = os.path.join(tmpdir, "private.sk")
+        pk = os.path.join(tmpdir, "public.pk")
+
+        assert test_keygen_range(tmpdir)
+        assert test_ehtk_roundtrip(tmpdir, sk)
+        assert test_colfilter_dedup(tmpdir, sk, pk)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,128 @@
+import asyncio
+import os
+import sys
+import tempfile
+
+from coordinator import Coordinator, format_vector, parse_vector
+
+"""
+Runs coordinator.py on a unix socket against two fake eht_descent workers and checks
+the protocol: runs are handed out in batches, a vector reported by one worker is
+sent to the other as KNOWN, and every worker gets STOP once the target is reached.
+Once the run budget is used up, a worker gets NOMORE instead, and the vectors of
+the runs it still has in progress are recorded before it hangs up.
+"""
+
+V1 = (1, 0, -2, 3)
+V2 = (0, 1, 1, -1)
+
+async def connect(path, name):
+	reader, writer = await asyncio.open_unix_connection(path)
+	writer.write(f"HELLO {name} 1\n".encode())
+	await writer.drain()
+	return reader, writer
+
+async def expect(reader, prefix):
+	line = (await asyncio.wait_for(reader.readline(), timeout=5)).decode().strip()
+	assert line.startswith(prefix), f"expected {prefix}, got {line!r}"
+	return line
+
+async def start(tmpdir, runs, target):
+	path = os.path.join(tmpdir, "coordinator.sock")
+	outfilename = os.path.join(tmpdir, "output_vecs.json")
+	coordinator = Coordinator(outfilename, seed=7, runs=runs, target=target, batch=4)
+	server = asyncio.create_task(coordinator.serve("unix:" + path))
+	while not os.path.exists(path):
+		await asyncio.sleep(0.01)
+	return coordinator, server, path, outfilename
+
+def read_found(outfilename):
+	with open(outfilename) as f:
+		return [parse_vector(line) for line in f if line.strip()]
+
+async def test_target(tmpdir):
+	coordinator, server, path, outfilename = await start(tmpdir, runs=100, target=2)
+
+	a_reader, a_writer = await connect(path, "a")
+	assert await expect(a_reader, "SEED") == "SEED 7"
+	b_reader, b_writer = await connect(path, "b")
+	assert await expect(b_reader, "SEED") == "SEED 7"
+
+	# Both workers get disjoint batches of runs
+	a_writer.write(b"MORE\n")
+	await a_writer.drain()
+	assert await expect(a_reader, "SEEDS") == "SEEDS 0 4"
+	b_writer.write(b"MORE\n")
+	await b_writer.drain()
+	assert await expect(b_reader, "SEEDS") == "SEEDS 4 4"
+
+	# A vector found by a is forwarded to b only
+	a_writer.write(f"VEC 0 {format_vector(V1)}\n".encode())
+	await a_writer.drain()
+	assert parse_vector((await expect(b_reader, "KNOWN")).split(" ", 1)[1]) == V1
+
+	# A duplicate does not count towards the target
+	b_writer.write(f"VEC 5 {format_vector(V1)}\n".encode())
+	await b_writer.drain()
+	assert not coordinator.done.is_set()
+
+	# The second distinct vector reaches the target: b is told about it, then both stop
+	a_writer.write(f"VEC 1 {format_vector(V2)}\n".encode())
+	await a_writer.drain()
+	assert parse_vector((await expect(b_reader, "KNOWN")).split(" ", 1)[1]) == V2
+	await expect(b_reader, "STOP")
+	await expect(a_reader, "STOP")
+
+	# Workers exit on STOP
+	for writer in (a_writer, b_writer):
+		writer.close()
+		await writer.wait_closed()
+	await asyncio.wait_for(server, timeout=5)
+
+	found = read_found(outfilename)
+	assert found == [V1, V2], found
+	print("The coordinator broadcasts KNOWN vectors and stops the workers at the target")
+	return True
+
+async def test_budget(tmpdir):
+	coordinator, server, path, outfilename = await start(tmpdir, runs=6, target=10)
+	reader, writer = await connect(path, "a")
+	await expect(reader, "SEED")
+
+	# Like eht_descent, ask for the next batch as soon as the last run of a batch is started
+	writer.write(b"MORE\n")
+	await writer.drain()
+	assert await expect(reader, "SEEDS") == "SEEDS 0 4"
+	writer.write(b"MORE\n")
+	await writer.drain()
+	assert await expect(reader, "SEEDS") == "SEEDS 4 2"
+	writer.write(b"MORE\n")
+	await writer.drain()
+	# Runs 4 and 5 are still in progress: the worker must not be told to abandon them
+	assert await expect(reader, "NOMORE") == "NOMORE"
+	assert not coordinator.done.is_set()
+
+	writer.write(f"VEC 5 {format_vector(V1)}\n".encode())
+	await writer.drain()
+	writer.write(f"VEC 4 {format_vector(V2)}\n".encode())
+	await writer.drain()
+	# Done with the last runs: hang up, and the coordinator finishes
+	writer.close()
+	await writer.wait_closed()
+	await asyncio.wait_for(server, timeout=5)
+
+	found = read_found(outfilename)
+	assert found == [V1, V2], found
+	assert coordinator.next_run == 6
+	print("Once all runs are handed out, the coordinator lets the workers finish the runs in progress")
+	return True
+
+def main():
+	with tempfile.TemporaryDirectory() as tmpdir:
+		assert asyncio.run(test_target(tmpdir))
+	with tempfile.TemporaryDirectory() as tmpdir:
+		assert asyncio.run(test_budget(tmpdir))
+
+
+if __name__ == "__main__":
+	main()
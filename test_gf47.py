@@ -0,0 +1,82 @@
+from sage.all import GF, Matrix, vector, set_random_seed, random_matrix
+
+import numpy as np
+
+import gf47
+
+"""
+Checks c_utils/libgf47.so (through gf47.py) against Sage on random matrices of the
+shapes the attack uses and on rank-deficient ones: the results must be the same,
+including the echelonized kernel bases that partial_key_recovery.py relies on.
+"""
+
+F = GF(gf47.Q)
+
+def as_numpy(M):
+    return np.array([[int(x) for x in row] for row in M.rows()], dtype=np.int64).reshape(M.nrows(), M.ncols())
+
+def low_rank(m, n, r):
+    return random_matrix(F, m, r) * random_matrix(F, r, n)
+
+def test_rref(A):
+    R, pivots = gf47.rref(as_numpy(A))
+    assert np.array_equal(R, as_numpy(A.echelon_form())), "rref differs"
+    assert pivots == tuple(A.pivots()), "pivots differ"
+    assert gf47.rank(as_numpy(A)) == A.rank()
+
+def test_kernels(A):
+    K = gf47.right_kernel(as_numpy(A))
+    assert np.array_equal(K, as_numpy(A.right_kernel().basis_matrix())), "right kernel differs"
+    K = gf47.left_kernel(as_numpy(A))
+    assert np.array_equal(K, as_numpy(A.left_kernel().basis_matrix())), "left kernel differs"
+
+def test_solve(A):
+    x = random_matrix(F, A.ncols(), 1).column(0)
+    b = A * x
+    y = gf47.solve_right(as_numpy(A), np.array([int(t) for t in b]))
+    assert A * vector(F, [int(t) for t in y]) == b, "solve_right returned a wrong solution"
+    if A.rank() < A.nrows():
+        # Some right-hand side is out of the column space
+        b = A.left_kernel().basis_matrix().row(0)
+        try:
+            gf47.solve_right(as_numpy(A), np.array([int(t) for t in b]))
+        except ValueError:
+            pass
+        else:
+            assert False, "solve_right did not reject an inconsistent system"
+
+def test_inverse_and_lu(A):
+    Ai = gf47.inverse(as_numpy(A))
+    assert np.array_equal(Ai, as_numpy(~A)), "inverse differs"
+    B = random_matrix(F, A.nrows(), 3)
+    X = gf47.LU(as_numpy(A)).solve(as_numpy(B))
+    assert np.array_equal(X, as_numpy(A.solve_right(B))), "LU solve differs"
+
+def test_singular(A):
+    for f in (gf47.inverse, gf47.LU):
+        try:
+            f(as_numpy(A))
+        except ZeroDivisionError:
+            pass
+        else:
+            assert False, "singular matrix was not rejected"
+
+def main():
+    set_random_seed(47)
+    for m, n, r in [(5, 7, 3), (30, 30, 30), (40, 25, 17), (242, 242, 242), (460, 484, 460), (460, 484, 440)]:
+        A = random_matrix(F, m, n) if r == min(m, n) else low_rank(m, n, r)
+        test_rref(A)
+        test_kernels(A)
+        test_solve(A)
+        print(f"rref, rank, kernels and solve_right agree with Sage on {m} x {n} of rank {A.rank()}")
+    for n in (1, 13, 242):
+        A = random_matrix(F, n, n)
+        while not A.is_invertible():
+            A = random_matrix(F, n, n)
+        test_inverse_and_lu(A)
+        test_singular(low_rank(n, n, n - 1) if n > 1 else Matrix(F, [[0]]))
+        print(f"inverse and LU agree with Sage on {n} x {n}")
+
+
+if __name__ == "__main__":
+    main()